@@ -1,13 +1,9 @@
 #include <zephyr/kernel.h>
 #include <gtp_buttons.h>
+#include <gtp_game.h>
 #include <gtp_menu.h>
 #include <gtp_display.h>
 #include <gtp_sound.h>
-#include <gtp_reactivity_game.h>
-#include <gtp_memory_game.h>
-#include <gtp_simple_sound_game.h>
-#include <gtp_traffic_game.h>
-#include <gtp_dual_speed_game.h>
 #include <app_version.h>
 
 #include <zephyr/logging/log.h>
@@ -17,7 +13,8 @@ void on_gtp_buttons_event_cb(const gtp_buttons_color_e color, const gtp_button_e
 {
 	if (gtp_menu_is_menu_mode()) {
 
-		if (event == GTP_BUTTON_EVENT_PRESSED) {
+		/* holding up or down scrolls the menu */
+		if (event == GTP_BUTTON_EVENT_PRESSED || event == GTP_BUTTON_EVENT_REPEAT) {
 			/* Only up / down and validate buttons are handled in menu mode */
 			const gtp_buttons_role_e role = (gtp_buttons_role_e)color;
 			switch (role) {
@@ -28,7 +25,13 @@ void on_gtp_buttons_event_cb(const gtp_buttons_color_e color, const gtp_button_e
 				gtp_menu_previous();
 				break;
 			case GTP_BUTTON_VALIDATE_ROLE:
+				if (event != GTP_BUTTON_EVENT_PRESSED) {
+					break;
+				}
 				LOG_INF("Validate");
+				gtp_display_set_transition(GTP_DISPLAY_TRANSITION_NONE);
+				gtp_buttons_set_all_leds_off();
+				gtp_buttons_set_input_mode(GTP_BUTTONS_INPUT_ACTIVE);
 				gtp_display_set_menu_mode(false);
 				gtp_menu_start_current_game();
 				break;
@@ -43,7 +46,44 @@ void on_gtp_buttons_event_cb(const gtp_buttons_color_e color, const gtp_button_e
 
 void on_gtp_menu_event_cb(const char *menu_to_display)
 {
-	gtp_display_print_sentence(menu_to_display, strlen(menu_to_display));
+	gtp_display_print_const_sentence(menu_to_display);
+}
+
+static void log_input_stats()
+{
+	gtp_buttons_input_stats_t stats;
+
+	for (int mode = 0; mode < GTP_BUTTONS_INPUT_MODES; ++mode) {
+		gtp_buttons_get_input_stats(mode, &stats);
+		LOG_DBG("input %s: %u scans/s, %u wakeups, %u events, latency avg %u max %u us",
+			mode == GTP_BUTTONS_INPUT_IDLE ? "idle" : "active", stats.scans_per_sec,
+			stats.wakeups, stats.events,
+			stats.events > 0 ? stats.total_latency_us / stats.events : 0,
+			stats.max_latency_us);
+	}
+}
+
+static void show_menu_leds()
+{
+#if defined(CONFIG_GTP_BUTTONS_LED_PWM)
+	/* the validate button breathes while browsing the menu */
+	gtp_buttons_set_led_breathing((gtp_buttons_color_e)GTP_BUTTON_VALIDATE_ROLE, 2000, 0);
+#endif
+}
+
+/* back to menu mode once a game or a song is done */
+static void on_game_finished(const int result)
+{
+	LOG_WRN("a game has been finished");
+	log_input_stats();
+	gtp_buttons_set_input_mode(GTP_BUTTONS_INPUT_IDLE);
+	gtp_buttons_set_cb(on_gtp_buttons_event_cb);
+	gtp_display_clear();
+	gtp_buttons_set_all_leds_off();
+	gtp_display_set_menu_mode(true);
+	gtp_display_set_transition(GTP_DISPLAY_TRANSITION_FADE);
+	gtp_menu_raise_cb();
+	show_menu_leds();
 }
 
 int main()
@@ -51,30 +91,9 @@ int main()
 	LOG_INF("starting game toy...");
 	LOG_WRN("Software version: %s", APP_VERSION_STRING);
 
-	gtp_reactivity_game_init();
-	gtp_revert_reactivity_game_init();
-	gtp_reactivity_phrase_game_init();
-	gtp_simple_sound_game_init();
-	gtp_memory_game_init();
-	gtp_traffic_escape_game_init();
-	gtp_traffic_catch_game_init();
-	gtp_dual_speed_game_init();
+	gtp_game_init();
 
 	gtp_menu_init();
-	gtp_menu_set_title(gtp_reactivity_game_get_menu_title(), gtp_reactivity_game_start);
-	gtp_menu_set_title(gtp_reactivity_phrase_game_get_menu_title(),
-			   gtp_reactivity_phrase_game_start);
-	gtp_menu_set_title(gtp_revert_reactivity_game_get_menu_title(),
-			   gtp_revert_reactivity_game_start);
-	gtp_menu_set_title(gtp_simple_sound_game_get_menu_title(), gtp_simple_sound_game_start);
-	gtp_menu_set_title(gtp_memory_game_get_menu_title(), gtp_memory_game_start);
-	gtp_menu_set_title(gtp_traffic_escape_game_get_menu_title(), gtp_traffic_escape_game_start);
-	gtp_menu_set_title(gtp_traffic_catch_game_get_menu_title(), gtp_traffic_catch_game_start);
-	gtp_menu_set_title(gtp_sound_tell_it_on_the_mountain_get_menu_title(),
-			   gtp_sound_tell_it_on_the_mountain_start);
-	gtp_menu_set_title(gtp_sound_merry_christmas_get_menu_title(),
-			   gtp_sound_a_merry_christmas_start);
-	gtp_menu_set_title(gtp_dual_speed_game_get_menu_title(), gtp_dual_speed_game_start);
 	gtp_menu_set_event_cb(on_gtp_menu_event_cb);
 
 	gtp_display_init();
@@ -84,34 +103,10 @@ int main()
 	gtp_buttons_set_cb(on_gtp_buttons_event_cb);
 
 	gtp_display_set_menu_mode(true);
+	gtp_display_set_transition(GTP_DISPLAY_TRANSITION_FADE);
 	gtp_menu_raise_cb();
+	show_menu_leds();
 
-	while (1) {
-		k_msleep(1000);
-
-		int ret = gtp_reactivity_game_play();
-		ret |= gtp_revert_reactivity_game_play();
-		ret |= gtp_reactivity_phrase_game_play();
-		ret |= gtp_simple_sound_game_play();
-		ret |= gtp_memory_game_play();
-		ret |= gtp_traffic_escape_game_play();
-		ret |= gtp_traffic_catch_game_play();
-		ret |= gtp_dual_speed_game_play();
-
-		/* song part */
-		ret |= gtp_sound_play_tell_it_on_the_mountain();
-		ret |= gtp_sound_play_merry_christmas();
-
-		/* if we reach here, that mean the current game is done.
-		 * back to menu mode again. */
-
-		if (ret > 0) {
-			LOG_WRN("a game has been finished");
-			gtp_buttons_set_cb(on_gtp_buttons_event_cb);
-			gtp_display_clear();
-			gtp_buttons_set_all_leds_off();
-			gtp_display_set_menu_mode(true);
-			gtp_menu_raise_cb();
-		}
-	}
+	/* the menu and the games run from here */
+	gtp_game_run_dispatcher(on_game_finished);
 }
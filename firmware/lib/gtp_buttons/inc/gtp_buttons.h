@@ -1,10 +1,15 @@
 #ifndef GTP_BUTTONS_H__
 #define GTP_BUTTONS_H__
 
-#define MAX_DURATION_MS   65500
-#define NUMBER_OF_BUTTONS 5
-
+#include <zephyr/devicetree.h>
+#include <zephyr/kernel.h>
 #include <zephyr/types.h>
+
+#define MAX_DURATION_MS 65500
+
+/* one button per child of the gpio-keys buttons node, the first ones are in
+ * gtp_buttons_color_e order */
+#define NUMBER_OF_BUTTONS DT_CHILD_NUM_STATUS_OKAY(DT_PATH(buttons))
 #include <stdbool.h>
 
 typedef enum {
@@ -24,10 +29,16 @@ typedef enum {
 	GTP_BUTTON_VALIDATE_ROLE = 4, // white
 } gtp_buttons_role_e;
 
+/* Gestures are only reported with CONFIG_GTP_BUTTONS_GESTURES, they come in
+ * addition to the pressed / released events. */
 typedef enum {
 	GTP_BUTTON_EVENT_NONE = 0,
 	GTP_BUTTON_EVENT_PRESSED = 1,
 	GTP_BUTTON_EVENT_RELEASED = 2,
+	GTP_BUTTON_EVENT_LONG_PRESS = 3, // held for CONFIG_GTP_BUTTONS_LONG_PRESS_MS
+	GTP_BUTTON_EVENT_REPEAT = 4,     // still held after the long press, faster and faster
+	GTP_BUTTON_EVENT_DOUBLE_TAP = 5, // second press shortly after a tap
+	GTP_BUTTON_EVENT_CHORD = 6,      // press while other buttons are held
 } gtp_button_event_e;
 
 typedef enum {
@@ -52,11 +63,97 @@ void gtp_buttons_set_leds(const uint8_t *colors, const int color_size,
 			  const gtp_button_status_e status, const int time_on_ms,
 			  const int time_off_ms, const int duration_ms);
 
+/* Sets all the leds at once, bit n of leds is the led of color n, e.g.
+ * BIT(GTP_BUTTON_RED_COLOR) | BIT(GTP_BUTTON_BLUE_COLOR). Leds sharing a gpio
+ * port are switched by a single write. Stops any blinking or effect. */
+void gtp_buttons_set_led_frame(const uint8_t leds);
+
+#if defined(CONFIG_GTP_BUTTONS_LED_PWM)
+/* Levels are perceived brightness in percent. The brightness is the level of
+ * the on state, used by set_led(s) and by blinking. Breathing goes from off to
+ * the brightness and back every period_ms, duration_ms 0 breathes till the led
+ * is changed. A fade ends holding to_percent. Any set_led(s) call stops the
+ * effect. */
+void gtp_buttons_set_led_brightness(const gtp_buttons_color_e color, const uint8_t percent);
+void gtp_buttons_set_led_breathing(const gtp_buttons_color_e color, const int period_ms,
+				   const int duration_ms);
+void gtp_buttons_set_led_fade(const gtp_buttons_color_e color, const uint8_t from_percent,
+			      const uint8_t to_percent, const int duration_ms);
+#endif
+
 typedef void (*on_gtp_buttons_event_cb_t)(const gtp_buttons_color_e color,
 					  const gtp_button_event_e event);
 
 void gtp_buttons_set_cb(on_gtp_buttons_event_cb_t cb);
 
+typedef struct {
+	gtp_buttons_color_e color;
+	gtp_button_event_e event;
+	/* hardware cycle counter captured in the GPIO interrupt on the first edge,
+	 * before any antibounce delay. */
+	uint32_t timestamp;
+	/* CHORD events: mask of the buttons held, bit n is the button of color n */
+	uint8_t buttons;
+} gtp_buttons_event_t;
+
+typedef void (*on_gtp_buttons_timed_event_cb_t)(const gtp_buttons_event_t *event);
+
+/* Same as gtp_buttons_set_cb but events come with their timestamp.
+ * Only one of the two callbacks is active at a time. */
+void gtp_buttons_set_timed_cb(on_gtp_buttons_timed_event_cb_t cb);
+
+/* Timestamps are hardware cycles, they wrap around so only intervals shorter
+ * than the counter period (2^32 cycles, ~89s at 48MHz) are meaningful, all of
+ * them are converted, wrap included. */
+uint32_t gtp_buttons_get_timestamp();
+uint32_t gtp_buttons_timestamp_to_us(const uint32_t from, const uint32_t to);
+
 bool gtp_buttons_is_all_pressed();
 
-#endif // GTP_BUTTONS_H__
\ No newline at end of file
+/* Events are queued and callbacks are called by the thread that drains the
+ * queue, the thread running the current game. This waits up to timeout for an
+ * event then processes all the pending ones. Returns the number of events
+ * processed.
+ * Setting a callback drops the events queued for the previous one. */
+int gtp_buttons_process_events(k_timeout_t timeout);
+void gtp_buttons_flush_events();
+
+#if defined(CONFIG_POLL)
+/* Sets up a poll event ready once events are queued, to wait for buttons along
+ * with other objects. Process them with gtp_buttons_process_events(K_NO_WAIT). */
+void gtp_buttons_init_poll_event(struct k_poll_event *event);
+#endif
+
+typedef struct {
+	uint32_t overflows; // events lost because the queue was full
+	uint32_t coalesced; // repeat presses merged (CONFIG_GTP_BUTTONS_EVENT_COALESCE)
+	uint32_t max_depth; // highest number of events waiting in the queue
+} gtp_buttons_queue_stats_t;
+
+void gtp_buttons_get_queue_stats(gtp_buttons_queue_stats_t *stats);
+
+/* The idle mode is for the menu, the active mode while a game runs. With the
+ * scanned input (CONFIG_GTP_BUTTONS_INPUT_SCAN) idle scans at a low rate till
+ * a button is touched, active always scans fast. With interrupts the mode
+ * only selects the statistics being updated. */
+typedef enum {
+	GTP_BUTTONS_INPUT_IDLE = 0,
+	GTP_BUTTONS_INPUT_ACTIVE = 1,
+	GTP_BUTTONS_INPUT_MODES,
+} gtp_buttons_input_mode_e;
+
+typedef struct {
+	uint32_t time_ms;          // time spent in the mode
+	uint32_t scans;            // port scans, 0 with interrupts
+	uint32_t scans_per_sec;    // average over time_ms
+	uint32_t wakeups;          // interrupts, timer expiries and works run for the buttons
+	uint32_t events;           // events reported
+	uint32_t total_latency_us; // from the first edge, or the first scan seeing it, to the report
+	uint32_t max_latency_us;
+} gtp_buttons_input_stats_t;
+
+void gtp_buttons_set_input_mode(const gtp_buttons_input_mode_e mode);
+void gtp_buttons_get_input_stats(const gtp_buttons_input_mode_e mode,
+				 gtp_buttons_input_stats_t *stats);
+
+#endif // GTP_BUTTONS_H__
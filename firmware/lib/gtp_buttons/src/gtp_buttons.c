@@ -3,217 +3,975 @@
 #include <zephyr/devicetree.h>
 #include <zephyr/kernel.h>
 
+#if defined(CONFIG_GTP_BUTTONS_LED_PWM)
+#include <zephyr/drivers/counter.h>
+#include <zephyr/drivers/pwm.h>
+#endif
+
 #include <zephyr/logging/log.h>
 LOG_MODULE_REGISTER(gtp_buttons, CONFIG_GTPBUTTONS_LOG_LEVEL);
 
-static on_gtp_buttons_event_cb_t on_gtp_buttons_event_cb;
+/* Callbacks are swapped by the game thread while the previous game may
+ * still be draining events, keep the accesses atomic. */
+static atomic_ptr_t on_gtp_buttons_event_cb = ATOMIC_PTR_INIT(NULL);
+static atomic_ptr_t on_gtp_buttons_timed_event_cb = ATOMIC_PTR_INIT(NULL);
 
 #define ANTIBOUNCE_TIME   K_MSEC(10)
-#define STACK_SIZE        256
-#define PRIORITY          5
-#define NUMBER_OF_BUTTONS 5
-#define BLINKY_PERIOD_MS  50
+#define LOCKOUT_TIME      K_MSEC(CONFIG_GTP_BUTTONS_DEBOUNCE_LOCKOUT_MS)
+#define ALL_LEDS_MASK     BIT_MASK(NUMBER_OF_BUTTONS)
+#define EVENT_QUEUE_SIZE  CONFIG_GTP_BUTTONS_EVENT_QUEUE_SIZE
+
+BUILD_ASSERT(IS_POWER_OF_TWO(EVENT_QUEUE_SIZE), "event queue size must be a power of two");
+
+/* the buttons are the children of the gpio-keys buttons node and their leds
+ * the children of the button_leds node, both in gtp_buttons_color_e order */
+#define BUTTONS_NODE     DT_PATH(buttons)
+#define BUTTON_LEDS_NODE DT_PATH(button_leds)
+
+BUILD_ASSERT(DT_CHILD_NUM_STATUS_OKAY(BUTTON_LEDS_NODE) == NUMBER_OF_BUTTONS,
+	     "each button needs a led");
+BUILD_ASSERT(NUMBER_OF_BUTTONS <= 8, "led frames and color masks are 8 bits");
+
+#define ASSERT_BUTTON_ORDER(color, COLOR)                                                          \
+	BUILD_ASSERT(DT_NODE_CHILD_IDX(DT_ALIAS(button##color##pin)) == GTP_BUTTON_##COLOR##_COLOR, \
+		     #color " button is not at its color index");                                  \
+	BUILD_ASSERT(DT_NODE_CHILD_IDX(DT_ALIAS(button##color##led)) == GTP_BUTTON_##COLOR##_COLOR, \
+		     #color " led is not at its color index");
+
+ASSERT_BUTTON_ORDER(red, RED)
+ASSERT_BUTTON_ORDER(blue, BLUE)
+ASSERT_BUTTON_ORDER(green, GREEN)
+ASSERT_BUTTON_ORDER(yellow, YELLOW)
+ASSERT_BUTTON_ORDER(white, WHITE)
+
+#if defined(CONFIG_GTP_BUTTONS_LED_PWM)
+#define LED_PWM_PERIOD_MS (MSEC_PER_SEC / CONFIG_GTP_BUTTONS_LED_PWM_FREQUENCY)
+#define LED_PWM_COUNTER   DT_ALIAS(buttonledpwmtimer)
+
+BUILD_ASSERT(MSEC_PER_SEC % CONFIG_GTP_BUTTONS_LED_PWM_FREQUENCY == 0,
+	     "led pwm period must be a whole number of milliseconds");
+#endif
 
 /* Prototypes */
-static void blinky_entry_point(void *, void *, void *);
-static void generic_pin_triggered_work(const struct gpio_dt_spec *pin,
-				       const gtp_buttons_color_e color);
 static void reset_led_blink_state(const gtp_buttons_color_e color, const int led_new_value);
 
-/* Useful macros */
-
-#define DECLARE_BUTTON(color, COLOR)                                                               \
-	static const struct gpio_dt_spec button_##color##_pin =                                    \
-		GPIO_DT_SPEC_GET(DT_ALIAS(button##color##pin), gpios);                             \
-	static const struct gpio_dt_spec button_##color##_led =                                    \
-		GPIO_DT_SPEC_GET(DT_ALIAS(button##color##led), gpios);                             \
-	static struct gpio_callback button_##color##_cb;                                           \
-                                                                                                   \
-	static void antibounce_button_##color##_expired(struct k_work *)                           \
-	{                                                                                          \
-		generic_pin_triggered_work(&button_##color##_pin, GTP_BUTTON_##COLOR##_COLOR);     \
-	}                                                                                          \
-                                                                                                   \
-	static K_WORK_DELAYABLE_DEFINE(antibounce_button_##color##_work,                           \
-				       antibounce_button_##color##_expired);                       \
-                                                                                                   \
-	static void button_##color##_pin_triggered(const struct device *dev,                       \
-						   struct gpio_callback *cb, uint32_t pins)        \
-	{                                                                                          \
-		k_work_reschedule(&antibounce_button_##color##_work, ANTIBOUNCE_TIME);             \
-	}
-
-#define CONFIGURE_BUTTON(color)                                                                    \
-	if (!gpio_is_ready_dt(&button_##color##_pin)) {                                            \
-		LOG_ERR("gpio not ready");                                                         \
-		return -EIO;                                                                       \
-	}                                                                                          \
-                                                                                                   \
-	if (gpio_pin_configure_dt(&button_##color##_pin, GPIO_INPUT) < 0) {                        \
-		return -ENODEV;                                                                    \
-	}                                                                                          \
-                                                                                                   \
-	ret = gpio_pin_interrupt_configure_dt(&button_##color##_pin, GPIO_INT_EDGE_BOTH);          \
-                                                                                                   \
-	if (ret != 0) {                                                                            \
-		LOG_ERR("Error %d: failed to configure interrupt on %s pin %d\n", ret,             \
-			button_##color##_pin.port->name, button_##color##_pin.pin);                \
-		return ret;                                                                        \
-	}                                                                                          \
-                                                                                                   \
-	gpio_init_callback(&button_##color##_cb, button_##color##_pin_triggered,                   \
-			   BIT(button_##color##_pin.pin));                                         \
-	ret = gpio_add_callback(button_##color##_pin.port, &button_##color##_cb);                  \
-	if (ret) {                                                                                 \
-		LOG_ERR("Failed to add GPIO callback");                                            \
-	}
-
-#define CONFIGURE_LED_BUTTON(color)                                                                \
-	if (!gpio_is_ready_dt(&button_##color##_led)) {                                            \
-		LOG_ERR("gpio not ready");                                                         \
-		return -EIO;                                                                       \
-	}                                                                                          \
-                                                                                                   \
-	if (gpio_pin_configure_dt(&button_##color##_led, GPIO_OUTPUT_INACTIVE) < 0) {              \
-		return -ENODEV;                                                                    \
-	}
-
-DECLARE_BUTTON(red, RED)
-DECLARE_BUTTON(white, WHITE)
-DECLARE_BUTTON(blue, BLUE)
-DECLARE_BUTTON(yellow, YELLOW)
-DECLARE_BUTTON(green, GREEN)
-
-K_THREAD_DEFINE(blinky_tid, STACK_SIZE, blinky_entry_point, NULL, NULL, NULL, PRIORITY, K_ESSENTIAL,
-		0);
-
-K_MUTEX_DEFINE(blinky_mutex);
+#define GPIO_SPEC_ENTRY(node) GPIO_DT_SPEC_GET(node, gpios),
+
+static const struct gpio_dt_spec button_pins[] = {
+	DT_FOREACH_CHILD_STATUS_OKAY(BUTTONS_NODE, GPIO_SPEC_ENTRY)};
+static const struct gpio_dt_spec button_leds[] = {
+	DT_FOREACH_CHILD_STATUS_OKAY(BUTTON_LEDS_NODE, GPIO_SPEC_ENTRY)};
+
+#if defined(CONFIG_GTP_BUTTONS_LED_PWM)
+/* the led of button n is wired to a timer channel when a buttonpwm<n> alias
+ * exists */
+#define LED_PWM_NODE(idx) DT_ALIAS(UTIL_CAT(buttonpwm, idx))
+#define DECLARE_LED_PWM(idx, _)                                                                    \
+	IF_ENABLED(DT_NODE_EXISTS(LED_PWM_NODE(idx)),                                              \
+		   (static const struct pwm_dt_spec led_pwm_##idx =                                \
+			    PWM_DT_SPEC_GET(LED_PWM_NODE(idx));))
+#define LED_PWM_ENTRY(idx, _) COND_CODE_1(DT_NODE_EXISTS(LED_PWM_NODE(idx)), (&led_pwm_##idx), (NULL))
+
+LISTIFY(NUMBER_OF_BUTTONS, DECLARE_LED_PWM, ())
+
+static const struct pwm_dt_spec *const led_pwms[] = {
+	LISTIFY(NUMBER_OF_BUTTONS, LED_PWM_ENTRY, (,))};
+#endif
 
+/* gpio ports of the buttons, filled at init */
+static const struct device *button_ports[NUMBER_OF_BUTTONS];
+static int button_port_count;
+
+#if defined(CONFIG_GTP_BUTTONS_INPUT_SCAN)
+#define SCAN_IDLE_PERIOD K_MSEC(CONFIG_GTP_BUTTONS_SCAN_IDLE_PERIOD_MS)
+#define SCAN_FAST_PERIOD K_MSEC(CONFIG_GTP_BUTTONS_SCAN_FAST_PERIOD_MS)
+
+static void scan_timer_expired(struct k_timer *timer);
+K_TIMER_DEFINE(scan_timer, scan_timer_expired, NULL);
+
+/* scan state, only used from the scan timer expiry */
+static uint8_t scan_stable;  // reported levels
+static uint8_t scan_pending; // levels that changed on the last scan
+static uint32_t scan_first_seen[NUMBER_OF_BUTTONS];
+static int64_t scan_fast_until_ms;
+static bool scan_fast;
+#else
 typedef struct {
-	int remaining_duration_ms;
+	struct k_work_delayable work; // antibounce, or lockout with the leading edge debounce
+	uint32_t first_edge;
+} button_debounce_t;
+
+static button_debounce_t button_debounce[NUMBER_OF_BUTTONS];
+
+/* one callback per gpio port, all the buttons of a port share it */
+static struct gpio_callback button_port_cbs[NUMBER_OF_BUTTONS];
+#endif
+
+/* input statistics of each mode */
+static gtp_buttons_input_stats_t input_stats[GTP_BUTTONS_INPUT_MODES];
+static gtp_buttons_input_mode_e input_mode = GTP_BUTTONS_INPUT_IDLE;
+static int64_t input_mode_since_ms;
+static struct k_spinlock input_stats_lock;
+
+static inline void count_input_wakeup(const bool scan)
+{
+	k_spinlock_key_t key = k_spin_lock(&input_stats_lock);
+	input_stats[input_mode].wakeups++;
+	if (scan) {
+		input_stats[input_mode].scans++;
+	}
+	k_spin_unlock(&input_stats_lock, key);
+}
+
+#if defined(CONFIG_GTP_BUTTONS_LED_PWM)
+typedef enum {
+	LED_EFFECT_NONE = 0,
+	LED_EFFECT_BREATHE,
+	LED_EFFECT_FADE,
+} led_effect_e;
+#endif
+
+/* Each LED has its own one shot timer, armed only while the LED blinks and
+ * only for the next phase change. Nothing runs when no LED is blinking. */
+typedef struct {
+	struct k_timer timer;
 	int const_time_on;
 	int const_time_off;
-	int remaining_state_time;
-	int state;
+	int64_t end_ms;         // uptime at which the blink stops
+	int64_t next_toggle_ms; // uptime at which the current phase ends
+	int state;              // level currently driven on the pin
 	const struct gpio_dt_spec *pin;
 	bool blink_mode_on;
-	gtp_buttons_color_e color;
+#if defined(CONFIG_GTP_BUTTONS_LED_PWM)
+	const struct pwm_dt_spec *pwm; // NULL when driven by the software pwm
+	uint32_t duty_ticks;           // software pwm on time, 0 when not dimmed
+	led_effect_e effect;
+	uint32_t effect_elapsed_ms;
+	uint32_t effect_period_ms;   // breathing period or fade duration
+	uint32_t effect_duration_ms; // breathing duration, 0 means till changed
+	uint8_t fade_from;
+	uint8_t fade_to;
+	uint8_t brightness; // level of the on state, in percent
+	uint8_t level;      // level currently driven, in percent
+#endif
+	uint8_t port_idx; // index in led_ports
 } led_state_t;
 
-static const uint8_t all_leds[] = {0, 1, 2, 3, 4};
+/* gpio ports of the leds, filled at init from the button_leds node */
+static const struct device *led_ports[NUMBER_OF_BUTTONS];
+static int led_port_count;
+
+/* led states are updated from the timers expiry, in interrupt context */
+static struct k_spinlock led_lock;
+
+#if defined(CONFIG_GTP_BUTTONS_LED_PWM)
+static const struct device *const led_pwm_counter = DEVICE_DT_GET(LED_PWM_COUNTER);
+static uint32_t led_pwm_period_ticks;
+static uint32_t led_pwm_last_edge;
+static bool led_pwm_running;
+
+static void led_pwm_period_expired(const struct device *dev, void *user_data);
+static void led_pwm_edge_expired(const struct device *dev, uint8_t chan, uint32_t ticks,
+				 void *user_data);
+#endif
+
+/* Button events are not handled in the interrupt nor in the antibounce work.
+ * They are pushed into a ring and the thread running the current game drains
+ * it, see gtp_buttons_process_events(). Producers only move the head and the
+ * consumer only moves the tail, so the consumer needs no lock. Events are
+ * produced from both the interrupt and the work with the leading edge
+ * debounce, producers are serialized by event_queue_lock. The semaphore is
+ * only used to wake up the consumer. */
+static gtp_buttons_event_t event_queue[EVENT_QUEUE_SIZE];
+static atomic_t event_queue_head = ATOMIC_INIT(0);
+static atomic_t event_queue_tail = ATOMIC_INIT(0);
+K_SEM_DEFINE(event_queue_sem, 0, 1);
+static struct k_spinlock event_queue_lock;
+
+static atomic_t queue_overflows = ATOMIC_INIT(0);
+static atomic_t queue_coalesced = ATOMIC_INIT(0);
+static atomic_t queue_max_depth = ATOMIC_INIT(0);
+
+#if defined(CONFIG_GTP_BUTTONS_EVENT_COALESCE)
+/* colors with a press waiting in the ring (set by the producer, cleared by
+ * the consumer) and colors whose next release must be dropped (producer only) */
+static atomic_t queued_presses = ATOMIC_INIT(0);
+static atomic_t coalesced_releases = ATOMIC_INIT(0);
+#endif
+
 static led_state_t led_state[NUMBER_OF_BUTTONS];
 static gtp_button_event_e button_state[NUMBER_OF_BUTTONS] = {GTP_BUTTON_EVENT_NONE};
 
-BUILD_ASSERT(GTP_BUTTON_RED_COLOR < sizeof(led_state) / sizeof(led_state[0]));
-BUILD_ASSERT(GTP_BUTTON_BLUE_COLOR < sizeof(led_state) / sizeof(led_state[0]));
-BUILD_ASSERT(GTP_BUTTON_GREEN_COLOR < sizeof(led_state) / sizeof(led_state[0]));
-BUILD_ASSERT(GTP_BUTTON_YELLOW_COLOR < sizeof(led_state) / sizeof(led_state[0]));
-BUILD_ASSERT(GTP_BUTTON_WHITE_COLOR < sizeof(led_state) / sizeof(led_state[0]));
 
-static void evaluate_led_state(led_state_t *led_state)
+#if defined(CONFIG_GTP_BUTTONS_LED_PWM)
+/* Brightness levels are perceived levels in percent, the duty cycle follows
+ * a square law (gamma 2) so that breathing and fades look linear. */
+static void led_pwm_output(led_state_t *led, const uint8_t level)
 {
-	if (led_state->blink_mode_on == false) {
+	/* this function must be called under led_lock protection only */
+	led->level = level;
+
+	if (led->pwm != NULL) {
+		pwm_set_pulse_dt(led->pwm, (uint64_t)led->pwm->period * level * level / 10000U);
+		return;
+	}
+
+	if (level == 0 || level >= 100) {
+		led->duty_ticks = 0;
+		gpio_pin_set_dt(led->pin, level > 0);
 		return;
 	}
 
-	// checking end blinking condition
-	if (led_state->remaining_duration_ms <= 0) {
-		reset_led_blink_state(led_state->color, 0);
+	led->duty_ticks = MAX((uint64_t)led_pwm_period_ticks * level * level / 10000U, 1U);
+
+	// the led is switched on at the next period
+	if (!led_pwm_running) {
+		led_pwm_running = true;
+		counter_start(led_pwm_counter);
+	}
+}
+
+static void led_pwm_start_effect(led_state_t *led)
+{
+	/* this function must be called under led_lock protection only */
+	k_timer_stop(&led->timer);
+	led->blink_mode_on = false;
+	led->state = 1;
+	led->effect_elapsed_ms = 0;
+
+	if (!led_pwm_running) {
+		led_pwm_running = true;
+		counter_start(led_pwm_counter);
+	}
+}
+
+static void cancel_led_effect(led_state_t *led)
+{
+	/* this function must be called under led_lock protection only */
+	if (led->effect != LED_EFFECT_NONE) {
+		led->effect = LED_EFFECT_NONE;
+		led_pwm_output(led, led->state ? led->brightness : 0);
+	}
+}
+
+static void step_led_effect(led_state_t *led)
+{
+	/* this function must be called under led_lock protection only */
+	uint32_t level;
+
+	led->effect_elapsed_ms += LED_PWM_PERIOD_MS;
 
+	if (led->effect == LED_EFFECT_FADE) {
+		if (led->effect_elapsed_ms >= led->effect_period_ms) {
+			led->effect = LED_EFFECT_NONE;
+			led->state = led->fade_to > 0;
+			level = led->fade_to;
+		} else {
+			level = led->fade_from + ((int)led->fade_to - (int)led->fade_from) *
+							 (int)led->effect_elapsed_ms /
+							 (int)led->effect_period_ms;
+		}
 	} else {
-		gpio_pin_set_dt(led_state->pin, led_state->state);
-		led_state->remaining_duration_ms -= BLINKY_PERIOD_MS;
-		led_state->remaining_state_time -= BLINKY_PERIOD_MS;
-
-		if (led_state->state == 1) {
-			if (led_state->remaining_state_time <= 0) {
-				// switch state from on to off!
-				led_state->state = 0;
-				led_state->remaining_state_time = led_state->const_time_off;
-			}
+		if (led->effect_duration_ms != 0 &&
+		    led->effect_elapsed_ms >= led->effect_duration_ms) {
+			led->effect = LED_EFFECT_NONE;
+			led->state = 0;
+			level = 0;
 		} else {
-			if (led_state->remaining_state_time <= 0) {
-				// switch state from off to on!
-				led_state->state = 1;
-				led_state->remaining_state_time = led_state->const_time_on;
-			}
+			// triangle from off to the led brightness and back
+			const uint32_t half = led->effect_period_ms / 2;
+			const uint32_t phase = led->effect_elapsed_ms % led->effect_period_ms;
+			const uint32_t ramp = phase < half ? phase : led->effect_period_ms - phase;
+			level = led->brightness * ramp / half;
+		}
+	}
+
+	if (level != led->level) {
+		led_pwm_output(led, level);
+	}
+}
+
+static void led_pwm_schedule_next_edge(const uint32_t now)
+{
+	/* this function must be called under led_lock protection only */
+	uint32_t next = UINT32_MAX;
+
+	for (int i = 0; i < NUMBER_OF_BUTTONS; ++i) {
+		const uint32_t duty = led_state[i].duty_ticks;
+
+		if (duty == 0) {
+			continue;
+		}
+
+		if (duty > led_pwm_last_edge && duty <= now) {
+			gpio_pin_set_dt(led_state[i].pin, 0);
+		} else if (duty > now) {
+			next = MIN(next, duty);
+		}
+	}
+
+	led_pwm_last_edge = now;
+
+	if (next != UINT32_MAX) {
+		const struct counter_alarm_cfg alarm = {
+			.callback = led_pwm_edge_expired,
+			.ticks = next,
+			.flags = COUNTER_ALARM_CFG_ABSOLUTE | COUNTER_ALARM_CFG_EXPIRE_WHEN_LATE,
+		};
+		counter_set_channel_alarm(led_pwm_counter, 0, &alarm);
+	}
+}
+
+static void led_pwm_edge_expired(const struct device *dev, uint8_t chan, uint32_t ticks,
+				 void *user_data)
+{
+	k_spinlock_key_t key = k_spin_lock(&led_lock);
+	led_pwm_schedule_next_edge(ticks);
+	k_spin_unlock(&led_lock, key);
+}
+
+/* Software pwm: every dimmed led is switched on at the start of the period
+ * and off by a compare alarm at its duty, at most one interrupt per led and
+ * per period. Effects are stepped once per period. The counter is stopped
+ * as soon as no led is dimmed nor has an effect. */
+static void led_pwm_period_expired(const struct device *dev, void *user_data)
+{
+	k_spinlock_key_t key = k_spin_lock(&led_lock);
+	bool busy = false;
+
+	for (int i = 0; i < NUMBER_OF_BUTTONS; ++i) {
+		if (led_state[i].effect != LED_EFFECT_NONE) {
+			step_led_effect(&led_state[i]);
+			busy = true;
+		}
+
+		if (led_state[i].duty_ticks != 0) {
+			gpio_pin_set_dt(led_state[i].pin, 1);
+			busy = true;
+		}
+	}
+
+	if (busy) {
+		led_pwm_last_edge = 0;
+		led_pwm_schedule_next_edge(0);
+	} else {
+		counter_stop(dev);
+		led_pwm_running = false;
+	}
+
+	k_spin_unlock(&led_lock, key);
+}
+#endif
+
+static void set_led_level(led_state_t *led, const int level)
+{
+	/* only touch the gpio on transitions */
+	if (led->state != level) {
+		led->state = level;
+#if defined(CONFIG_GTP_BUTTONS_LED_PWM)
+		led_pwm_output(led, level ? led->brightness : 0);
+#else
+		gpio_pin_set_dt(led->pin, level);
+#endif
+	}
+}
+
+static void start_led_phase(led_state_t *led, int level)
+{
+	/* this function must be called under led_lock protection only */
+	int phase_ms = level ? led->const_time_on : led->const_time_off;
+
+	// skip zero length phases
+	if (phase_ms <= 0) {
+		level = !level;
+		phase_ms = level ? led->const_time_on : led->const_time_off;
+	}
+
+	// no time on and no time off, keep the led on till the end
+	if (phase_ms <= 0) {
+		level = 1;
+		phase_ms = led->end_ms - led->next_toggle_ms;
+	}
+
+	set_led_level(led, level);
+
+	/* phases are chained on absolute deadlines so they do not drift */
+	led->next_toggle_ms = MIN(led->next_toggle_ms + phase_ms, led->end_ms);
+	k_timer_start(&led->timer, K_MSEC(MAX(led->next_toggle_ms - k_uptime_get(), 0)),
+		      K_NO_WAIT);
+}
+
+static void led_timer_expired(struct k_timer *timer)
+{
+	led_state_t *led = CONTAINER_OF(timer, led_state_t, timer);
+	k_spinlock_key_t key = k_spin_lock(&led_lock);
+
+	if (led->blink_mode_on) {
+		// checking end blinking condition
+		if (led->next_toggle_ms >= led->end_ms) {
+			reset_led_blink_state(led - led_state, 0);
+		} else {
+			start_led_phase(led, !led->state);
+		}
+	}
+
+	k_spin_unlock(&led_lock, key);
+}
+
+static void event_queue_push(const gtp_buttons_event_t *evt)
+{
+	/* this function must be called under event_queue_lock protection only */
+#if defined(CONFIG_GTP_BUTTONS_EVENT_COALESCE)
+	/* a press is already waiting for this button, the game did not see it
+	 * yet. Drop this repeat press and its release. */
+	if (evt->event == GTP_BUTTON_EVENT_PRESSED && atomic_test_bit(&queued_presses, evt->color)) {
+		atomic_set_bit(&coalesced_releases, evt->color);
+		atomic_inc(&queue_coalesced);
+		return;
+	}
+
+	if (evt->event == GTP_BUTTON_EVENT_RELEASED &&
+	    atomic_test_and_clear_bit(&coalesced_releases, evt->color)) {
+		return;
+	}
+#endif
+
+	const atomic_val_t head = atomic_get(&event_queue_head);
+	const atomic_val_t depth = head - atomic_get(&event_queue_tail);
+
+	if (depth >= EVENT_QUEUE_SIZE) {
+		atomic_inc(&queue_overflows);
+		return;
+	}
+
+	if (depth + 1 > atomic_get(&queue_max_depth)) {
+		atomic_set(&queue_max_depth, depth + 1);
+	}
+
+	event_queue[head & (EVENT_QUEUE_SIZE - 1)] = *evt;
+
+#if defined(CONFIG_GTP_BUTTONS_EVENT_COALESCE)
+	if (evt->event == GTP_BUTTON_EVENT_PRESSED) {
+		atomic_set_bit(&queued_presses, evt->color);
+	}
+#endif
+
+	/* publish the event only once it is fully written */
+	atomic_set(&event_queue_head, head + 1);
+	k_sem_give(&event_queue_sem);
+}
+
+static bool event_queue_pop(gtp_buttons_event_t *evt)
+{
+	const atomic_val_t tail = atomic_get(&event_queue_tail);
+
+	if (tail == atomic_get(&event_queue_head)) {
+		return false;
+	}
+
+	*evt = event_queue[tail & (EVENT_QUEUE_SIZE - 1)];
+
+#if defined(CONFIG_GTP_BUTTONS_EVENT_COALESCE)
+	if (evt->event == GTP_BUTTON_EVENT_PRESSED) {
+		atomic_clear_bit(&queued_presses, evt->color);
+	}
+#endif
+
+	/* release the slot only once it has been read */
+	atomic_set(&event_queue_tail, tail + 1);
+	return true;
+}
+
+#if defined(CONFIG_GTP_BUTTONS_GESTURES)
+/* Gestures are built from the debounced edges as they are queued, a timer per
+ * button generates the long press and the repeats. All the gesture state is
+ * protected by event_queue_lock. */
+static struct k_timer gesture_timers[NUMBER_OF_BUTTONS];
+static uint32_t repeat_interval_ms[NUMBER_OF_BUTTONS];
+static uint32_t last_press[NUMBER_OF_BUTTONS];
+static uint32_t last_tap_release[NUMBER_OF_BUTTONS];
+static uint8_t taps; // buttons whose last press was a short tap
+static uint8_t held;
+
+static void push_gesture(const int idx, const gtp_button_event_e event, const uint32_t timestamp,
+			 const uint8_t buttons)
+{
+	/* this function must be called under event_queue_lock protection only */
+	const gtp_buttons_event_t evt = {
+		.color = idx,
+		.event = event,
+		.timestamp = timestamp,
+		.buttons = buttons,
+	};
+
+	event_queue_push(&evt);
+}
+
+static void gesture_timer_expired(struct k_timer *timer)
+{
+	const int idx = timer - gesture_timers;
+	k_spinlock_key_t key = k_spin_lock(&event_queue_lock);
+
+	if (held & BIT(idx)) {
+		/* the first expiry is the long press, the next ones repeat faster
+		 * and faster */
+		if (repeat_interval_ms[idx] == 0) {
+			push_gesture(idx, GTP_BUTTON_EVENT_LONG_PRESS, k_cycle_get_32(), 0);
+			repeat_interval_ms[idx] = CONFIG_GTP_BUTTONS_REPEAT_INTERVAL_MS;
+		} else {
+			push_gesture(idx, GTP_BUTTON_EVENT_REPEAT, k_cycle_get_32(), 0);
+			repeat_interval_ms[idx] = MAX(repeat_interval_ms[idx] * 3 / 4,
+						      CONFIG_GTP_BUTTONS_REPEAT_MIN_INTERVAL_MS);
+		}
+		k_timer_start(timer, K_MSEC(repeat_interval_ms[idx]), K_NO_WAIT);
+	}
+
+	k_spin_unlock(&event_queue_lock, key);
+}
+
+static void gesture_on_edge(const gtp_buttons_event_t *evt)
+{
+	/* this function must be called under event_queue_lock protection only */
+	const int idx = evt->color;
+
+	if (evt->event == GTP_BUTTON_EVENT_PRESSED) {
+		held |= BIT(idx);
+		last_press[idx] = evt->timestamp;
+		repeat_interval_ms[idx] = 0;
+
+		/* the timer is started from the edge, not from the report */
+		const uint32_t since_edge_ms =
+			gtp_buttons_timestamp_to_us(evt->timestamp, k_cycle_get_32()) /
+			USEC_PER_MSEC;
+		k_timer_start(&gesture_timers[idx],
+			      K_MSEC(CONFIG_GTP_BUTTONS_LONG_PRESS_MS -
+				     MIN(since_edge_ms, CONFIG_GTP_BUTTONS_LONG_PRESS_MS)),
+			      K_NO_WAIT);
+
+		if ((taps & BIT(idx)) &&
+		    gtp_buttons_timestamp_to_us(last_tap_release[idx], evt->timestamp) <
+			    CONFIG_GTP_BUTTONS_DOUBLE_TAP_MS * USEC_PER_MSEC) {
+			push_gesture(idx, GTP_BUTTON_EVENT_DOUBLE_TAP, evt->timestamp, 0);
+			// a third tap starts a new double tap
+			taps &= ~BIT(idx);
+		}
+
+		// at least two buttons held
+		if ((held & (held - 1)) != 0) {
+			push_gesture(idx, GTP_BUTTON_EVENT_CHORD, evt->timestamp, held);
+		}
+	} else if (evt->event == GTP_BUTTON_EVENT_RELEASED) {
+		k_timer_stop(&gesture_timers[idx]);
+		held &= ~BIT(idx);
+
+		/* a release before the long press ends a tap */
+		if (repeat_interval_ms[idx] == 0 &&
+		    gtp_buttons_timestamp_to_us(last_press[idx], evt->timestamp) <
+			    CONFIG_GTP_BUTTONS_LONG_PRESS_MS * USEC_PER_MSEC) {
+			taps |= BIT(idx);
+			last_tap_release[idx] = evt->timestamp;
+		} else {
+			taps &= ~BIT(idx);
 		}
 	}
 }
+#endif
 
-static void blinky_entry_point(void *, void *, void *)
+/* Queues the event of a button level. With the leading edge debounce, a
+ * level equal to the last reported one is a glitch (or a bounce that ended
+ * where it started) and is not reported. Returns whether an event was queued. */
+static bool report_button_level(const int idx, const int level, const uint32_t timestamp)
 {
-	while (1) {
+	const gtp_buttons_event_t evt = {
+		.color = idx,
+		.event = level == 1 ? GTP_BUTTON_EVENT_PRESSED : GTP_BUTTON_EVENT_RELEASED,
+		.timestamp = timestamp,
+	};
+	bool reported = false;
+	k_spinlock_key_t key = k_spin_lock(&event_queue_lock);
+
+	if (!IS_ENABLED(CONFIG_GTP_BUTTONS_DEBOUNCE_LEADING) || evt.event != button_state[idx]) {
+		button_state[idx] = evt.event;
+		event_queue_push(&evt);
+#if defined(CONFIG_GTP_BUTTONS_GESTURES)
+		gesture_on_edge(&evt);
+#endif
+		reported = true;
+	}
+
+	k_spin_unlock(&event_queue_lock, key);
+
+	if (reported) {
+		const uint32_t latency_us = gtp_buttons_timestamp_to_us(timestamp, k_cycle_get_32());
 
-		k_mutex_lock(&blinky_mutex, K_FOREVER);
+		key = k_spin_lock(&input_stats_lock);
+		input_stats[input_mode].events++;
+		input_stats[input_mode].total_latency_us += latency_us;
+		input_stats[input_mode].max_latency_us =
+			MAX(input_stats[input_mode].max_latency_us, latency_us);
+		k_spin_unlock(&input_stats_lock, key);
+	}
+
+	return reported;
+}
+
+#if defined(CONFIG_GTP_BUTTONS_INPUT_SCAN)
+static void set_scan_period(const bool fast)
+{
+	if (fast != scan_fast) {
+		scan_fast = fast;
+		k_timer_start(&scan_timer, fast ? SCAN_FAST_PERIOD : SCAN_IDLE_PERIOD,
+			      fast ? SCAN_FAST_PERIOD : SCAN_IDLE_PERIOD);
+	}
+}
+
+/* Every port is read once per scan. A level must be read on two scans in a
+ * row to be reported, which debounces the switches. The scan runs at the idle
+ * period, it switches to the fast period in active mode, while a button is
+ * pressed or a level is changing, and for a while after the last change. */
+static void scan_timer_expired(struct k_timer *timer)
+{
+	const uint32_t now = k_cycle_get_32();
+	uint8_t levels = 0;
+
+	count_input_wakeup(true);
+
+	for (int p = 0; p < button_port_count; ++p) {
+		gpio_port_value_t value;
+
+		if (gpio_port_get(button_ports[p], &value) != 0) {
+			continue;
+		}
 
 		for (int i = 0; i < NUMBER_OF_BUTTONS; ++i) {
-			evaluate_led_state(&led_state[i]);
+			if (button_pins[i].port == button_ports[p] &&
+			    (value & BIT(button_pins[i].pin)) != 0) {
+				levels |= BIT(i);
+			}
 		}
+	}
 
-		k_mutex_unlock(&blinky_mutex);
+	for (int i = 0; i < NUMBER_OF_BUTTONS; ++i) {
+		const int level = (levels >> i) & 1;
 
-		k_sleep(K_MSEC(BLINKY_PERIOD_MS));
+		if (level == ((scan_stable >> i) & 1)) {
+			scan_pending &= ~BIT(i);
+		} else if ((scan_pending & BIT(i)) == 0) {
+			scan_pending |= BIT(i);
+			scan_first_seen[i] = now;
+		} else {
+			scan_pending &= ~BIT(i);
+			scan_stable ^= BIT(i);
+			report_button_level(i, level, scan_first_seen[i]);
+		}
+	}
+
+	if (levels != scan_stable || scan_pending != 0) {
+		scan_fast_until_ms = k_uptime_get() + CONFIG_GTP_BUTTONS_SCAN_FAST_HOLD_MS;
 	}
+
+	set_scan_period(input_mode == GTP_BUTTONS_INPUT_ACTIVE || scan_stable != 0 ||
+			k_uptime_get() < scan_fast_until_ms);
 }
+#else
 
-static void generic_pin_triggered_work(const struct gpio_dt_spec *pin,
-				       const gtp_buttons_color_e color)
+static void debounce_work_expired(struct k_work *work)
 {
-	const gtp_button_event_e evt =
-		gpio_pin_get_dt(pin) == 1 ? GTP_BUTTON_EVENT_PRESSED : GTP_BUTTON_EVENT_RELEASED;
+	button_debounce_t *debounce =
+		CONTAINER_OF(k_work_delayable_from_work(work), button_debounce_t, work);
+	const int idx = debounce - button_debounce;
 
-	button_state[color] = evt;
+	count_input_wakeup(false);
 
-	if (on_gtp_buttons_event_cb != NULL) {
-		on_gtp_buttons_event_cb(color, evt);
+#if defined(CONFIG_GTP_BUTTONS_DEBOUNCE_LEADING)
+	/* end of the lockout, read the pin again to catch a change that
+	 * happened while it was ignored */
+	if (report_button_level(idx, gpio_pin_get_dt(&button_pins[idx]), k_cycle_get_32())) {
+		k_work_schedule(&debounce->work, LOCKOUT_TIME);
+	}
+#else
+	/* the pin has been stable for ANTIBOUNCE_TIME */
+	report_button_level(idx, gpio_pin_get_dt(&button_pins[idx]), debounce->first_edge);
+#endif
+}
+
+/* Called once per interrupt for all the buttons of a port that have an edge,
+ * the port is read only once. */
+static void buttons_port_triggered(const struct device *port, struct gpio_callback *cb,
+				   uint32_t pins)
+{
+	const uint32_t timestamp = k_cycle_get_32();
+
+	count_input_wakeup(false);
+
+#if defined(CONFIG_GTP_BUTTONS_DEBOUNCE_LEADING)
+	/* The first edge is reported right away, then the button is ignored
+	 * during the lockout. */
+	uint8_t unlocked = 0;
+	gpio_port_value_t value;
+
+	for (int i = 0; i < NUMBER_OF_BUTTONS; ++i) {
+		if (button_pins[i].port == port && (pins & BIT(button_pins[i].pin)) != 0 &&
+		    !k_work_delayable_is_pending(&button_debounce[i].work)) {
+			unlocked |= BIT(i);
+		}
+	}
+
+	if (unlocked == 0) {
+		return;
+	}
+
+#if CONFIG_GTP_BUTTONS_GLITCH_FILTER_US > 0
+	/* a glitch is over before the port is read */
+	k_busy_wait(CONFIG_GTP_BUTTONS_GLITCH_FILTER_US);
+#endif
+
+	if (gpio_port_get(port, &value) != 0) {
+		return;
+	}
+
+	for (int i = 0; i < NUMBER_OF_BUTTONS; ++i) {
+		if ((unlocked & BIT(i)) != 0 &&
+		    report_button_level(i, (value >> button_pins[i].pin) & 1, timestamp)) {
+			k_work_schedule(&button_debounce[i].work, LOCKOUT_TIME);
+		}
+	}
+#else
+	/* The first edge is the real press / release time, the next ones are
+	 * bounces that only postpone the antibounce work. */
+	for (int i = 0; i < NUMBER_OF_BUTTONS; ++i) {
+		if (button_pins[i].port != port || (pins & BIT(button_pins[i].pin)) == 0) {
+			continue;
+		}
+
+		if (!k_work_delayable_is_pending(&button_debounce[i].work)) {
+			button_debounce[i].first_edge = timestamp;
+		}
+		k_work_reschedule(&button_debounce[i].work, ANTIBOUNCE_TIME);
+	}
+#endif
+}
+#endif
+
+/* Stops blinking and effects of the leds in the leds mask and drives them
+ * to their bit in values. The pins are written with one masked write per
+ * port, so all the leds of a frame switch at the same time. */
+static void write_led_frame(const uint8_t leds, const uint8_t values)
+{
+	/* this function must be called under led_lock protection only */
+	gpio_port_pins_t port_masks[NUMBER_OF_BUTTONS] = {0};
+	gpio_port_value_t port_values[NUMBER_OF_BUTTONS] = {0};
+
+	for (int i = 0; i < NUMBER_OF_BUTTONS; ++i) {
+		led_state_t *led = &led_state[i];
+		const int level = (values >> i) & 1;
+
+		if ((leds & BIT(i)) == 0) {
+			continue;
+		}
+
+		k_timer_stop(&led->timer);
+		led->end_ms = 0;
+		led->next_toggle_ms = 0;
+		led->const_time_on = 0;
+		led->const_time_off = 0;
+		led->blink_mode_on = false;
+
+#if defined(CONFIG_GTP_BUTTONS_LED_PWM)
+		led->effect = LED_EFFECT_NONE;
+
+		// dimmed and timer driven leds are not part of the gpio frame
+		if (led->pwm != NULL || (level && led->brightness < 100)) {
+			led->state = level;
+			led_pwm_output(led, level ? led->brightness : 0);
+			continue;
+		}
+
+		const bool was_dimmed = led->duty_ticks != 0;
+
+		led->duty_ticks = 0;
+		led->level = level ? 100 : 0;
+
+		/* only touch the gpio on transitions */
+		if (led->state == level && !was_dimmed) {
+			continue;
+		}
+#else
+		/* only touch the gpio on transitions */
+		if (led->state == level) {
+			continue;
+		}
+#endif
+
+		led->state = level;
+		port_masks[led->port_idx] |= BIT(led->pin->pin);
+		if (level) {
+			port_values[led->port_idx] |= BIT(led->pin->pin);
+		}
+	}
+
+	for (int p = 0; p < led_port_count; ++p) {
+		if (port_masks[p] != 0) {
+			gpio_port_set_masked(led_ports[p], port_masks[p], port_values[p]);
+		}
 	}
 }
 
 static void reset_led_blink_state(const gtp_buttons_color_e color, const int led_new_value)
 {
-	/* this function must be called under mutex protection only */
-	gpio_pin_set_dt(led_state[color].pin, led_new_value);
-	led_state[color].state = 0;
-	led_state[color].remaining_duration_ms = 0;
-	led_state[color].const_time_on = 0;
-	led_state[color].const_time_off = 0;
-	led_state[color].remaining_state_time = 0;
-	led_state[color].blink_mode_on = false;
+	/* this function must be called under led_lock protection only */
+	write_led_frame(BIT(color), led_new_value ? BIT(color) : 0);
 }
 
-int gtp_buttons_init()
+/* returns the index of port in ports, adding it when missing */
+static int get_port_idx(const struct device **ports, int *count, const struct device *port)
 {
+	int p = 0;
+
+	while (p < *count && ports[p] != port) {
+		p++;
+	}
+	if (p == *count) {
+		ports[(*count)++] = port;
+	}
+	return p;
+}
+
+static int configure_buttons()
+{
+	gpio_port_pins_t port_pins[NUMBER_OF_BUTTONS] = {0};
+
+	button_port_count = 0;
+	for (int i = 0; i < NUMBER_OF_BUTTONS; ++i) {
+		const struct gpio_dt_spec *pin = &button_pins[i];
+
+		if (!gpio_is_ready_dt(pin)) {
+			LOG_ERR("gpio not ready");
+			return -EIO;
+		}
+
+		if (gpio_pin_configure_dt(pin, GPIO_INPUT) < 0) {
+			return -ENODEV;
+		}
+
+		port_pins[get_port_idx(button_ports, &button_port_count, pin->port)] |=
+			BIT(pin->pin);
+	}
+
+#if defined(CONFIG_GTP_BUTTONS_INPUT_SCAN)
+	/* no interrupt, the pins are scanned */
+	input_mode_since_ms = k_uptime_get();
+	scan_fast = true;
+	set_scan_period(false);
+#else
 	int ret;
 
-	CONFIGURE_BUTTON(red)
-	CONFIGURE_BUTTON(white)
-	CONFIGURE_BUTTON(blue)
-	CONFIGURE_BUTTON(yellow)
-	CONFIGURE_BUTTON(green)
+	for (int i = 0; i < NUMBER_OF_BUTTONS; ++i) {
+		k_work_init_delayable(&button_debounce[i].work, debounce_work_expired);
+	}
+
+	for (int p = 0; p < button_port_count; ++p) {
+		gpio_init_callback(&button_port_cbs[p], buttons_port_triggered, port_pins[p]);
+		ret = gpio_add_callback(button_ports[p], &button_port_cbs[p]);
+		if (ret) {
+			LOG_ERR("Failed to add GPIO callback");
+			return ret;
+		}
+	}
+
+	for (int i = 0; i < NUMBER_OF_BUTTONS; ++i) {
+		ret = gpio_pin_interrupt_configure_dt(&button_pins[i], GPIO_INT_EDGE_BOTH);
+		if (ret != 0) {
+			LOG_ERR("Error %d: failed to configure interrupt on %s pin %d\n", ret,
+				button_pins[i].port->name, button_pins[i].pin);
+			return ret;
+		}
+	}
+
+	input_mode_since_ms = k_uptime_get();
+#endif
 
-	CONFIGURE_LED_BUTTON(red)
-	CONFIGURE_LED_BUTTON(white)
-	CONFIGURE_LED_BUTTON(blue)
-	CONFIGURE_LED_BUTTON(yellow)
-	CONFIGURE_LED_BUTTON(green)
+	return 0;
+}
 
+static int configure_leds()
+{
 	memset(&led_state, 0, sizeof(led_state));
-	led_state[GTP_BUTTON_RED_COLOR].pin = &button_red_led;
-	led_state[GTP_BUTTON_RED_COLOR].color = GTP_BUTTON_RED_COLOR;
-	led_state[GTP_BUTTON_BLUE_COLOR].pin = &button_blue_led;
-	led_state[GTP_BUTTON_BLUE_COLOR].color = GTP_BUTTON_BLUE_COLOR;
-	led_state[GTP_BUTTON_GREEN_COLOR].pin = &button_green_led;
-	led_state[GTP_BUTTON_GREEN_COLOR].color = GTP_BUTTON_GREEN_COLOR;
-	led_state[GTP_BUTTON_YELLOW_COLOR].pin = &button_yellow_led;
-	led_state[GTP_BUTTON_YELLOW_COLOR].color = GTP_BUTTON_YELLOW_COLOR;
-	led_state[GTP_BUTTON_WHITE_COLOR].pin = &button_white_led;
-	led_state[GTP_BUTTON_WHITE_COLOR].color = GTP_BUTTON_WHITE_COLOR;
-	reset_led_blink_state(GTP_BUTTON_RED_COLOR, 0);
-	reset_led_blink_state(GTP_BUTTON_BLUE_COLOR, 0);
-	reset_led_blink_state(GTP_BUTTON_GREEN_COLOR, 0);
-	reset_led_blink_state(GTP_BUTTON_YELLOW_COLOR, 0);
-	reset_led_blink_state(GTP_BUTTON_WHITE_COLOR, 0);
+	led_port_count = 0;
+
+	for (int i = 0; i < NUMBER_OF_BUTTONS; ++i) {
+		led_state[i].pin = &button_leds[i];
+		k_timer_init(&led_state[i].timer, led_timer_expired, NULL);
+
+#if defined(CONFIG_GTP_BUTTONS_LED_PWM)
+		led_state[i].pwm = led_pwms[i];
+		led_state[i].brightness = 100;
+
+		if (led_pwms[i] != NULL) {
+			/* the pin belongs to the timer, do not turn it back into a gpio */
+			if (!pwm_is_ready_dt(led_pwms[i])) {
+				LOG_ERR("pwm not ready");
+				return -EIO;
+			}
+			continue;
+		}
+#endif
+
+		if (!gpio_is_ready_dt(&button_leds[i])) {
+			LOG_ERR("gpio not ready");
+			return -EIO;
+		}
+
+		/* configured inactive, state 0 matches the pin */
+		if (gpio_pin_configure_dt(&button_leds[i], GPIO_OUTPUT_INACTIVE) < 0) {
+			return -ENODEV;
+		}
+
+		/* group the leds by port for the frame writes */
+		led_state[i].port_idx =
+			get_port_idx(led_ports, &led_port_count, button_leds[i].port);
+	}
+
+	return 0;
+}
+
+int gtp_buttons_init()
+{
+#if defined(CONFIG_GTP_BUTTONS_GESTURES)
+	for (int i = 0; i < NUMBER_OF_BUTTONS; ++i) {
+		k_timer_init(&gesture_timers[i], gesture_timer_expired, NULL);
+	}
+#endif
+
+	int ret = configure_buttons();
+	if (ret != 0) {
+		return ret;
+	}
+
+	ret = configure_leds();
+	if (ret != 0) {
+		return ret;
+	}
+
+#if defined(CONFIG_GTP_BUTTONS_LED_PWM)
+	if (!device_is_ready(led_pwm_counter)) {
+		LOG_ERR("led pwm counter not ready");
+		return -EIO;
+	}
+
+	const struct counter_top_cfg top = {
+		.ticks = counter_us_to_ticks(led_pwm_counter, LED_PWM_PERIOD_MS * USEC_PER_MSEC),
+		.callback = led_pwm_period_expired,
+	};
+	led_pwm_period_ticks = top.ticks;
+	ret = counter_set_top_value(led_pwm_counter, &top);
+	if (ret != 0) {
+		LOG_ERR("Error %d: failed to set the led pwm period", ret);
+		return ret;
+	}
+#endif
+
+	write_led_frame(ALL_LEDS_MASK, 0);
 
 	return 0;
 }
@@ -221,20 +979,31 @@ int gtp_buttons_init()
 static inline void configure_start_blink(const int idx, const int time_on_ms, const int time_off_ms,
 					 const int duration_ms)
 {
+	/* this function must be called under led_lock protection only */
+	if (duration_ms <= 0) {
+		reset_led_blink_state(idx, 0);
+		return;
+	}
+
+	const int64_t now = k_uptime_get();
+
+#if defined(CONFIG_GTP_BUTTONS_LED_PWM)
+	/* the effect would keep stepping the level over the blink phases */
+	cancel_led_effect(&led_state[idx]);
+#endif
+
 	led_state[idx].const_time_on = time_on_ms;
 	led_state[idx].const_time_off = time_off_ms;
-	// if start_state is 0, remaining_state_time must be the time off.
-	// else, remaining_state_time must be the time on.
-	led_state[idx].remaining_state_time = time_on_ms;
-	led_state[idx].remaining_duration_ms = duration_ms;
-	led_state[idx].state = 1;
+	led_state[idx].end_ms = now + duration_ms;
+	led_state[idx].next_toggle_ms = now;
 	led_state[idx].blink_mode_on = true;
+	// blinking starts with the led on
+	start_led_phase(&led_state[idx], 1);
 }
 
 void gtp_buttons_set_all_leds_off()
 {
-	gtp_buttons_set_leds(all_leds, sizeof(all_leds) / sizeof(all_leds[0]),
-			     GTP_BUTTON_STATUS_OFF, 0, 0, 0);
+	gtp_buttons_set_led_frame(0);
 }
 
 void gtp_buttons_set_led(const gtp_buttons_color_e color, const gtp_button_status_e status)
@@ -248,12 +1017,6 @@ void gtp_buttons_set_led(const gtp_buttons_color_e color, const gtp_button_statu
 		return;
 	}
 
-	if (color == GTP_BUTTON_ALL_COLOR) {
-		gtp_buttons_set_leds(all_leds, sizeof(all_leds) / sizeof(all_leds[0]), status, 0, 0,
-				     0);
-		return;
-	}
-
 	gtp_buttons_set_leds((const uint8_t *)&color, 1, status, 0, 0, 0);
 }
 
@@ -265,24 +1028,20 @@ void gtp_buttons_set_leds(const uint8_t *colors, const int color_size,
 	__ASSERT(color_size > 0, "invalid color size", NULL);
 	for (int i = 0; i < color_size; ++i) {
 		__ASSERT(colors[i] >= 0, "invalid color", NULL);
-		__ASSERT(colors[i] < NUMBER_OF_BUTTONS, "invalid color", NULL);
+		__ASSERT(colors[i] < NUMBER_OF_BUTTONS || colors[i] == GTP_BUTTON_ALL_COLOR,
+			 "invalid color", NULL);
 	}
-	__ASSERT(duration_ms % BLINKY_PERIOD_MS == 0, "invalid duration", NULL);
-	__ASSERT(time_on_ms % BLINKY_PERIOD_MS == 0, "invalid time on", NULL);
-	__ASSERT(time_off_ms % BLINKY_PERIOD_MS == 0, "invalid time off", NULL);
-	__ASSERT(color != GTP_BUTTON_NONE_COLOR, "invalid color", NULL);
 	__ASSERT(status != GTP_BUTTON_STATUS_NONE, "invalid status", NULL);
 
-	k_mutex_lock(&blinky_mutex, K_FOREVER);
+	uint8_t frame_leds = 0;
+	k_spinlock_key_t key = k_spin_lock(&led_lock);
 
 	for (int color_idx = 0; color_idx < color_size; ++color_idx) {
 		if (status == GTP_BUTTON_STATUS_ON || status == GTP_BUTTON_STATUS_OFF) {
 			if (colors[color_idx] == GTP_BUTTON_ALL_COLOR) {
-				for (int i = 0; i < NUMBER_OF_BUTTONS; ++i) {
-					reset_led_blink_state(i, status);
-				}
+				frame_leds = ALL_LEDS_MASK;
 			} else {
-				reset_led_blink_state(colors[color_idx], status);
+				frame_leds |= BIT(colors[color_idx]);
 			}
 		}
 
@@ -299,19 +1058,215 @@ void gtp_buttons_set_leds(const uint8_t *colors, const int color_size,
 		}
 	}
 
-	k_mutex_unlock(&blinky_mutex);
+	if (frame_leds != 0) {
+		write_led_frame(frame_leds, status == GTP_BUTTON_STATUS_ON ? frame_leds : 0);
+	}
+
+	k_spin_unlock(&led_lock, key);
+}
+
+void gtp_buttons_set_led_frame(const uint8_t leds)
+{
+	k_spinlock_key_t key = k_spin_lock(&led_lock);
+	write_led_frame(ALL_LEDS_MASK, leds);
+	k_spin_unlock(&led_lock, key);
+}
+
+#if defined(CONFIG_GTP_BUTTONS_LED_PWM)
+static inline bool is_led_selected(const gtp_buttons_color_e color, const int idx)
+{
+	return color == GTP_BUTTON_ALL_COLOR || color == idx;
 }
 
+void gtp_buttons_set_led_brightness(const gtp_buttons_color_e color, const uint8_t percent)
+{
+	__ASSERT(color != GTP_BUTTON_NONE_COLOR, "invalid color", NULL);
+
+	k_spinlock_key_t key = k_spin_lock(&led_lock);
+
+	for (int i = 0; i < NUMBER_OF_BUTTONS; ++i) {
+		if (!is_led_selected(color, i)) {
+			continue;
+		}
+
+		led_state[i].brightness = MIN(percent, 100);
+		if (led_state[i].state && led_state[i].effect == LED_EFFECT_NONE) {
+			led_pwm_output(&led_state[i], led_state[i].brightness);
+		}
+	}
+
+	k_spin_unlock(&led_lock, key);
+}
+
+void gtp_buttons_set_led_breathing(const gtp_buttons_color_e color, const int period_ms,
+				   const int duration_ms)
+{
+	__ASSERT(color != GTP_BUTTON_NONE_COLOR, "invalid color", NULL);
+	__ASSERT(period_ms >= 2 * LED_PWM_PERIOD_MS, "invalid period", NULL);
+
+	k_spinlock_key_t key = k_spin_lock(&led_lock);
+
+	for (int i = 0; i < NUMBER_OF_BUTTONS; ++i) {
+		if (!is_led_selected(color, i)) {
+			continue;
+		}
+
+		led_state[i].effect = LED_EFFECT_BREATHE;
+		led_state[i].effect_period_ms = period_ms;
+		led_state[i].effect_duration_ms = MAX(duration_ms, 0);
+		led_pwm_start_effect(&led_state[i]);
+	}
+
+	k_spin_unlock(&led_lock, key);
+}
+
+void gtp_buttons_set_led_fade(const gtp_buttons_color_e color, const uint8_t from_percent,
+			      const uint8_t to_percent, const int duration_ms)
+{
+	__ASSERT(color != GTP_BUTTON_NONE_COLOR, "invalid color", NULL);
+
+	k_spinlock_key_t key = k_spin_lock(&led_lock);
+
+	for (int i = 0; i < NUMBER_OF_BUTTONS; ++i) {
+		if (!is_led_selected(color, i)) {
+			continue;
+		}
+
+		led_state[i].effect = LED_EFFECT_FADE;
+		led_state[i].effect_period_ms = MAX(duration_ms, 1);
+		led_state[i].fade_from = MIN(from_percent, 100);
+		led_state[i].fade_to = MIN(to_percent, 100);
+		led_pwm_start_effect(&led_state[i]);
+		led_pwm_output(&led_state[i], led_state[i].fade_from);
+	}
+
+	k_spin_unlock(&led_lock, key);
+}
+#endif
+
 void gtp_buttons_set_cb(on_gtp_buttons_event_cb_t cb)
 {
-	on_gtp_buttons_event_cb = cb;
+	gtp_buttons_flush_events();
+	atomic_ptr_set(&on_gtp_buttons_timed_event_cb, NULL);
+	atomic_ptr_set(&on_gtp_buttons_event_cb, (void *)cb);
+}
+
+void gtp_buttons_set_timed_cb(on_gtp_buttons_timed_event_cb_t cb)
+{
+	gtp_buttons_flush_events();
+	atomic_ptr_set(&on_gtp_buttons_event_cb, NULL);
+	atomic_ptr_set(&on_gtp_buttons_timed_event_cb, (void *)cb);
+}
+
+int gtp_buttons_process_events(k_timeout_t timeout)
+{
+	gtp_buttons_event_t evt;
+	int processed = 0;
+
+	if (event_queue_pop(&evt) == false) {
+		/* the semaphore may have been given for events already processed,
+		 * so check the ring again after each wake up */
+		const k_timepoint_t end = sys_timepoint_calc(timeout);
+		do {
+			if (k_sem_take(&event_queue_sem, sys_timepoint_timeout(end)) != 0) {
+				return 0;
+			}
+		} while (event_queue_pop(&evt) == false);
+	}
+
+	do {
+		const on_gtp_buttons_timed_event_cb_t timed_cb =
+			(on_gtp_buttons_timed_event_cb_t)atomic_ptr_get(&on_gtp_buttons_timed_event_cb);
+		const on_gtp_buttons_event_cb_t cb =
+			(on_gtp_buttons_event_cb_t)atomic_ptr_get(&on_gtp_buttons_event_cb);
+
+		if (timed_cb != NULL) {
+			timed_cb(&evt);
+		} else if (cb != NULL) {
+			cb(evt.color, evt.event);
+		}
+		processed++;
+
+	} while (event_queue_pop(&evt));
+
+	return processed;
+}
+
+#if defined(CONFIG_POLL)
+void gtp_buttons_init_poll_event(struct k_poll_event *event)
+{
+	k_poll_event_init(event, K_POLL_TYPE_SEM_AVAILABLE, K_POLL_MODE_NOTIFY_ONLY,
+			  &event_queue_sem);
+}
+#endif
+
+void gtp_buttons_flush_events()
+{
+	gtp_buttons_event_t evt;
+
+	while (event_queue_pop(&evt)) {
+	}
+}
+
+void gtp_buttons_get_queue_stats(gtp_buttons_queue_stats_t *stats)
+{
+	stats->overflows = atomic_get(&queue_overflows);
+	stats->coalesced = atomic_get(&queue_coalesced);
+	stats->max_depth = atomic_get(&queue_max_depth);
+}
+
+uint32_t gtp_buttons_get_timestamp()
+{
+	return k_cycle_get_32();
+}
+
+uint32_t gtp_buttons_timestamp_to_us(const uint32_t from, const uint32_t to)
+{
+	/* the unsigned difference is right across a counter wrap */
+	return (uint32_t)k_cyc_to_us_floor64(to - from);
+}
+
+void gtp_buttons_set_input_mode(const gtp_buttons_input_mode_e mode)
+{
+	k_spinlock_key_t key = k_spin_lock(&input_stats_lock);
+	const int64_t now = k_uptime_get();
+
+	input_stats[input_mode].time_ms += now - input_mode_since_ms;
+	input_mode_since_ms = now;
+	input_mode = mode;
+
+	k_spin_unlock(&input_stats_lock, key);
+
+#if defined(CONFIG_GTP_BUTTONS_INPUT_SCAN)
+	/* apply the new period now rather than at the next idle scan */
+	if (mode == GTP_BUTTONS_INPUT_ACTIVE) {
+		k_timer_start(&scan_timer, K_NO_WAIT, SCAN_FAST_PERIOD);
+	}
+#endif
+}
+
+void gtp_buttons_get_input_stats(const gtp_buttons_input_mode_e mode,
+				 gtp_buttons_input_stats_t *stats)
+{
+	k_spinlock_key_t key = k_spin_lock(&input_stats_lock);
+
+	*stats = input_stats[mode];
+	if (mode == input_mode) {
+		stats->time_ms += k_uptime_get() - input_mode_since_ms;
+	}
+
+	k_spin_unlock(&input_stats_lock, key);
+
+	stats->scans_per_sec =
+		stats->time_ms > 0 ? (uint64_t)stats->scans * MSEC_PER_SEC / stats->time_ms : 0;
 }
 
 bool gtp_buttons_is_all_pressed()
 {
-	return button_state[GTP_BUTTON_RED_COLOR] == GTP_BUTTON_EVENT_PRESSED &&
-	       button_state[GTP_BUTTON_BLUE_COLOR] == GTP_BUTTON_EVENT_PRESSED &&
-	       button_state[GTP_BUTTON_GREEN_COLOR] == GTP_BUTTON_EVENT_PRESSED &&
-	       button_state[GTP_BUTTON_YELLOW_COLOR] == GTP_BUTTON_EVENT_PRESSED &&
-	       button_state[GTP_BUTTON_WHITE_COLOR] == GTP_BUTTON_EVENT_PRESSED;
+	for (int i = 0; i < NUMBER_OF_BUTTONS; ++i) {
+		if (button_state[i] != GTP_BUTTON_EVENT_PRESSED) {
+			return false;
+		}
+	}
+	return true;
 }
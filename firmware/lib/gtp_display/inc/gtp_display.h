@@ -6,11 +6,27 @@
 
 #define DISPLAY_WIDTH 32
 
+typedef enum {
+	GTP_DISPLAY_TRANSITION_NONE = 0,
+	/* fade out the previous text, swap and fade in the new one, using the
+	 * hardware intensity of the modules */
+	GTP_DISPLAY_TRANSITION_FADE = 1,
+} gtp_display_transition_e;
+
 int gtp_display_init();
 void gtp_display_clear();
 void gtp_display_set_min_max_display_area(const int min, const int max);
 void gtp_display_print_sentence(const char *s, const size_t size);
+/* Zero-copy version of gtp_display_print_sentence, without any length limit.
+ * The string is read while it is displayed so it must stay valid and
+ * unchanged until something else is printed (string literals, const tables). */
+void gtp_display_print_const_sentence(const char *s);
 void gtp_display_set_menu_mode(const bool on);
 void gtp_display_print_buf(const char *buf);
+void gtp_display_set_transition(const gtp_display_transition_e transition);
+/* Intensity goes from 0 to 15, it can be set for all or for a single 8x8 module
+ * (0 is the left one), for example to highlight part of the screen. */
+void gtp_display_set_intensity(const uint8_t intensity);
+void gtp_display_set_module_intensity(const int module, const uint8_t intensity);
 
 #endif // GTP_DISPLAY_H__
@@ -1,18 +1,25 @@
 #include "gtp_display.h"
 #include <zephyr/kernel.h>
 #include <zephyr/drivers/display.h>
+#include <zephyr/drivers/spi.h>
 #include <stdlib.h>
 #include <string.h>
 #include <zephyr/logging/log.h>
 LOG_MODULE_REGISTER(gtpdisplay, LOG_LEVEL_DBG);
 
-const struct device *display_dev = DEVICE_DT_GET(DT_CHOSEN(zephyr_display));
+#define DISPLAY_NODE DT_CHOSEN(zephyr_display)
+
+const struct device *display_dev = DEVICE_DT_GET(DISPLAY_NODE);
 static struct display_capabilities capabilities;
 static struct display_buffer_descriptor buf_desc;
 
 #define STACK_SIZE 512
 #define PRIORITY   5
 
+#define SHIFT_START_DELAY_MS 500
+#define SHIFT_STEP_MS        50
+#define SHIFT_END_DELAY_MS   1000
+
 /* When the menu is ON with cursors, cursors are 5 LEDs wide + 1 column of space.
  * So the cursor overall takes 6 columns of LEDs, nothing should override that. */
 #define DISPLAY_WIDTH_MENU_ON (DISPLAY_WIDTH - 6)
@@ -20,7 +27,11 @@ static struct display_buffer_descriptor buf_desc;
 // the display buffer that holds data
 static uint8_t buf[DISPLAY_WIDTH];
 
+#if defined(CONFIG_GTP_DISPLAY_WORKQUEUE)
+static void display_work_handler(struct k_work *work);
+#else
 static void gtp_display_entry_point(void *, void *, void *);
+#endif
 
 /* I'am using a dot matrix 8x32 display. It's a 8x8 dot matrix chained using
  * 4 modules in series.
@@ -55,29 +66,66 @@ static void gtp_display_entry_point(void *, void *, void *);
  * bit0, bit1, bit2, ... bit7 horizontally.
  */
 
+#if defined(CONFIG_GTP_DISPLAY_WORKQUEUE)
+K_WORK_DELAYABLE_DEFINE(display_work, display_work_handler);
+#else
 K_THREAD_DEFINE(gtp_display_tid, STACK_SIZE, gtp_display_entry_point, NULL, NULL, NULL, PRIORITY,
 		K_ESSENTIAL, 0);
+#endif
 
 K_MUTEX_DEFINE(gtp_display_mutex);
 
 #define GTP_DISPLAY_EVENT_NEW_WORD             0x01u
-#define GTP_DISPLAY_EVENT_SHIFT_TEXT           0x02u
 #define GTP_DISPLAY_EVENT_SWITCH_MENU_MODE_ON  0x04u
 #define GTP_DISPLAY_EVENT_SWITCH_MENU_MODE_OFF 0x08u
+#define GTP_DISPLAY_EVENT_INTENSITY            0x10u
 
 #define GTP_DISPLAY_ALL_EVENTS_MASK                                                                \
-	(GTP_DISPLAY_EVENT_NEW_WORD | GTP_DISPLAY_EVENT_SHIFT_TEXT |                               \
-	 GTP_DISPLAY_EVENT_SWITCH_MENU_MODE_ON | GTP_DISPLAY_EVENT_SWITCH_MENU_MODE_OFF)
+	(GTP_DISPLAY_EVENT_NEW_WORD | GTP_DISPLAY_EVENT_SWITCH_MENU_MODE_ON |                      \
+	 GTP_DISPLAY_EVENT_SWITCH_MENU_MODE_OFF | GTP_DISPLAY_EVENT_INTENSITY)
 
 K_EVENT_DEFINE(gtp_display_event);
 
+static inline void post_display_event(const uint32_t event)
+{
+	k_event_post(&gtp_display_event, event);
+#if defined(CONFIG_GTP_DISPLAY_WORKQUEUE)
+	k_work_reschedule(&display_work, K_NO_WAIT);
+#endif
+}
+
 static int min_x_display_area = 0;
 static int max_x_display_area = DISPLAY_WIDTH - 1;
 static bool menu_mode = false;
+static gtp_display_transition_e transition = GTP_DISPLAY_TRANSITION_NONE;
+
+/* The brightness is handled by the MAX7219 themselves, each module of the
+ * chain has its own 4 bits intensity register. Changing it only costs a
+ * 2 bytes register write per module, we use it for transitions instead of
+ * redrawing frames.
+ * Registers are written directly on the SPI bus of the display, the zephyr
+ * driver only offers a global brightness. */
+#define MAX7219_REG_NOOP      0x00
+#define MAX7219_REG_INTENSITY 0x0A
+#define MAX7219_REG_SHUTDOWN  0x0C
+#define MAX7219_MAX_INTENSITY 0x0F
+#define NUMBER_OF_MODULES     DT_PROP(DISPLAY_NODE, num_cascading)
+
+BUILD_ASSERT(NUMBER_OF_MODULES * 8 == DISPLAY_WIDTH);
+
+static const struct spi_dt_spec max7219_spi =
+	SPI_DT_SPEC_GET(DISPLAY_NODE, SPI_OP_MODE_MASTER | SPI_WORD_SET(8U), 0U);
+
+// intensity requested for each module, index 0 is the left module
+static uint8_t module_intensity[NUMBER_OF_MODULES];
 
 #define SENTENCE_SIZE 64
 static char sentence[SENTENCE_SIZE] = {0};
 
+/* Text to display, points either to the sentence buffer or to a constant
+ * string given by the caller (see gtp_display_print_const_sentence). */
+static const char *text = sentence;
+
 typedef struct {
 	char symbol;
 	char mask[8];
@@ -211,6 +259,7 @@ static void init_symbols_lookup_table()
 int gtp_display_init()
 {
 	init_symbols_lookup_table();
+	memset(module_intensity, DT_PROP(DISPLAY_NODE, intensity), sizeof(module_intensity));
 
 	if (!device_is_ready(display_dev)) {
 		LOG_ERR("Device %s not found. Aborting sample.", display_dev->name);
@@ -227,7 +276,7 @@ int gtp_display_init()
 
 void gtp_display_clear()
 {
-	gtp_display_print_sentence("", 0);
+	gtp_display_print_const_sentence("");
 }
 
 static inline void set_min_max_display_area(const int min, const int max)
@@ -248,7 +297,17 @@ void gtp_display_print_sentence(const char *s, const size_t size)
 	__ASSERT_NO_MSG(size < sizeof(sentence));
 	k_mutex_lock(&gtp_display_mutex, K_FOREVER);
 	strlcpy(sentence, s, sizeof(sentence));
-	k_event_post(&gtp_display_event, GTP_DISPLAY_EVENT_NEW_WORD);
+	text = sentence;
+	post_display_event(GTP_DISPLAY_EVENT_NEW_WORD);
+	k_mutex_unlock(&gtp_display_mutex);
+}
+
+void gtp_display_print_const_sentence(const char *s)
+{
+	__ASSERT_NO_MSG(s != NULL);
+	k_mutex_lock(&gtp_display_mutex, K_FOREVER);
+	text = s;
+	post_display_event(GTP_DISPLAY_EVENT_NEW_WORD);
 	k_mutex_unlock(&gtp_display_mutex);
 }
 
@@ -305,17 +364,43 @@ void gtp_display_set_menu_mode(const bool on)
 	if (menu_mode == false && on == true) {
 		LOG_INF("switching to menu mode");
 		menu_mode = on;
-		k_event_post(&gtp_display_event, GTP_DISPLAY_EVENT_SWITCH_MENU_MODE_ON);
+		post_display_event(GTP_DISPLAY_EVENT_SWITCH_MENU_MODE_ON);
 
 	} else if (menu_mode == true && on == false) {
 		LOG_INF("switching to normal mode");
 		menu_mode = on;
-		k_event_post(&gtp_display_event, GTP_DISPLAY_EVENT_SWITCH_MENU_MODE_OFF);
+		post_display_event(GTP_DISPLAY_EVENT_SWITCH_MENU_MODE_OFF);
 	}
 
 	k_mutex_unlock(&gtp_display_mutex);
 }
 
+void gtp_display_set_transition(const gtp_display_transition_e new_transition)
+{
+	k_mutex_lock(&gtp_display_mutex, K_FOREVER);
+	transition = new_transition;
+	k_mutex_unlock(&gtp_display_mutex);
+}
+
+void gtp_display_set_intensity(const uint8_t intensity)
+{
+	__ASSERT_NO_MSG(intensity <= MAX7219_MAX_INTENSITY);
+	k_mutex_lock(&gtp_display_mutex, K_FOREVER);
+	memset(module_intensity, intensity, sizeof(module_intensity));
+	post_display_event(GTP_DISPLAY_EVENT_INTENSITY);
+	k_mutex_unlock(&gtp_display_mutex);
+}
+
+void gtp_display_set_module_intensity(const int module, const uint8_t intensity)
+{
+	__ASSERT_NO_MSG(module >= 0 && module < NUMBER_OF_MODULES);
+	__ASSERT_NO_MSG(intensity <= MAX7219_MAX_INTENSITY);
+	k_mutex_lock(&gtp_display_mutex, K_FOREVER);
+	module_intensity[module] = intensity;
+	post_display_event(GTP_DISPLAY_EVENT_INTENSITY);
+	k_mutex_unlock(&gtp_display_mutex);
+}
+
 void gtp_display_print_buf(const char *buf)
 {
 	display_write(display_dev, 0, 0, &buf_desc, buf);
@@ -396,16 +481,6 @@ static void gtp_display_add_letter(const char mask[8], int *idx, const int max_i
 	}
 }
 
-static inline int get_total_dot_led_length(const char *s)
-{
-	int res = 0;
-	for (int i = 0; i < strlen(s); ++i) {
-		res += symbols_lookup_table[s[i] - ASCII_OFFSET]->width;
-		res += 1; // add space between all letters
-	}
-	return res;
-}
-
 static inline void add_menu_mode_arrows(const bool menu_mode)
 {
 	if (menu_mode) {
@@ -416,63 +491,357 @@ static inline void add_menu_mode_arrows(const bool menu_mode)
 	}
 }
 
-static void add_sentence(const int global_offset, const char *local_sentence,
-			 const int max_x_display)
+/* The text is never copied by the display thread. It is streamed column
+ * by column from wherever it lives (the sentence buffer or a constant string
+ * in flash), the cursor only remembers the next glyph and the next column of
+ * that glyph to scroll in. */
+typedef struct {
+	const char *c;
+	int column; // column of *c to render next, == width means the spacing column
+} text_cursor_t;
+
+static inline void text_cursor_reset(text_cursor_t *cursor, const char *s)
+{
+	cursor->c = s;
+	cursor->column = 0;
+}
+
+static inline const display_symbol_t *get_symbol(const char c)
+{
+	if (c < ASCII_OFFSET || c >= (ASCII_OFFSET + sizeof(symbols) / sizeof(symbols[0]))) {
+		LOG_WRN("Character '%c' not valid", c);
+		return NULL;
+	}
+
+	const display_symbol_t *symbol = symbols_lookup_table[c - ASCII_OFFSET];
+	if (symbol == NULL) {
+		LOG_ERR("Character not found in lookup table: %c", c);
+	}
+
+	return symbol;
+}
+
+/* Get the next column of dots of the text, bit N being the row N.
+ * Returns false once the whole text has been consumed. */
+static bool text_cursor_next_column(text_cursor_t *cursor, uint8_t *column)
 {
-	memset(buf, 0, sizeof(buf));
-	int idx = global_offset;
+	const display_symbol_t *symbol = NULL;
 
-	for (const char *c = local_sentence; *c != '\0'; ++c) {
-		if (*c < ASCII_OFFSET ||
-		    *c >= (ASCII_OFFSET + sizeof(symbols) / sizeof(symbols[0]))) {
-			LOG_WRN("Character '%c' not valid", *c);
-			continue;
+	while (*cursor->c != '\0') {
+		symbol = get_symbol(*cursor->c);
+		if (symbol != NULL) {
+			break;
 		}
+		cursor->c++;
+	}
 
-		const display_symbol_t *symbol = symbols_lookup_table[*c - ASCII_OFFSET];
-		if (symbol) {
-			gtp_display_add_letter(symbol->mask, &idx, max_x_display);
-			idx += symbol->width;
-			idx += 1; // space between symbol
+	if (symbol == NULL) {
+		return false;
+	}
+
+	*column = 0;
+
+	if (cursor->column < symbol->width) {
+		for (int row = 0; row < 8; ++row) {
+			*column |= ((symbol->mask[row] >> cursor->column) & 0x01) << row;
+		}
+		cursor->column++;
+	} else {
+		// space between symbol
+		cursor->c++;
+		cursor->column = 0;
+	}
+
+	return true;
+}
+
+static inline void set_column(const int x, const uint8_t column)
+{
+	for (int row = 0; row < 8; ++row) {
+		const int buf_idx = row + (x / 8) * 8;
+		if (column & BIT(row)) {
+			buf[buf_idx] |= BIT(x % 8);
 		} else {
-			LOG_ERR("Character not found in lookup table: %c", *c);
+			buf[buf_idx] &= ~BIT(x % 8);
 		}
 	}
 }
 
-static void gtp_display_entry_point(void *, void *, void *)
+/* Shift the text area [0; max_x[ by one dot to the left and insert the
+ * column on its right side. Whatever is displayed after max_x (menu arrows)
+ * stays in place. */
+static void shift_in_column(const uint8_t column, const int max_x)
 {
-	// init local variables
-#define RESET_VARIABLES()                                                                          \
-	global_offset = 0;                                                                         \
-	total_dot_led_length = get_total_dot_led_length(local_sentence);                           \
-	idx = 0;
-
-	char local_sentence[SENTENCE_SIZE] = {0};
-	int global_offset = 0;
-	int total_dot_led_length = 0;
-	int idx = 0;
-	int local_max_x_display = max_x_display_area;
-	bool local_menu_mode = false;
-	bool local_shift_needed = false;
-
-#define INTERRUPTIBLE_SLEEP(max_ms)                                                                \
-	for (int i = 0; i < (max_ms / 10); ++i) {                                                  \
-		k_msleep(10);                                                                      \
-		uint32_t now_event = k_event_wait(&gtp_display_event, GTP_DISPLAY_ALL_EVENTS_MASK, \
-						  false, K_NO_WAIT);                               \
-		if (now_event != 0 && now_event != event) {                                        \
-			break;                                                                     \
-		}                                                                                  \
+	const uint32_t area_mask = max_x >= DISPLAY_WIDTH ? UINT32_MAX : BIT(max_x) - 1;
+
+	for (int row = 0; row < 8; ++row) {
+		uint32_t line = buf[row] | buf[row + 8] << 8 | buf[row + 16] << 16 |
+				(uint32_t)buf[row + 24] << 24;
+
+		uint32_t text_line = (line & area_mask) >> 1;
+		text_line |= (uint32_t)((column >> row) & 0x01) << (max_x - 1);
+		line = (line & ~area_mask) | text_line;
+
+		buf[row] = line;
+		buf[row + 8] = line >> 8;
+		buf[row + 16] = line >> 16;
+		buf[row + 24] = line >> 24;
 	}
+}
 
-	while (1) {
+/* Render the beginning of the text into the text area.
+ * Returns true if some text remains, meaning it needs to be shifted. */
+static bool fill_text_area(text_cursor_t *cursor, const bool menu_mode, const int max_x)
+{
+	bool remaining = true;
 
-		uint32_t event = k_event_wait(&gtp_display_event, GTP_DISPLAY_ALL_EVENTS_MASK,
-					      false, K_FOREVER);
-		// LOG_DBG("event: %d", event);
+	memset(buf, 0, sizeof(buf));
+	add_menu_mode_arrows(menu_mode);
+
+	for (int x = 0; x < max_x && remaining; ++x) {
+		uint8_t column;
+		remaining = text_cursor_next_column(cursor, &column);
+		if (remaining) {
+			set_column(x, column);
+		}
+	}
+
+	if (remaining) {
+		text_cursor_t lookahead = *cursor;
+		uint8_t column;
+		remaining = text_cursor_next_column(&lookahead, &column);
+	}
+
+	return remaining;
+}
+
+/* Write one register of every module of the chain in a single transfer.
+ * The first bytes shifted out end up in the last module of the chain. */
+static int write_modules_register(const uint8_t reg, const uint8_t values[NUMBER_OF_MODULES])
+{
+	uint8_t tx[2 * NUMBER_OF_MODULES];
+
+	for (int module = 0; module < NUMBER_OF_MODULES; ++module) {
+		const int pos = NUMBER_OF_MODULES - 1 - module;
+		tx[2 * pos] = reg;
+		tx[2 * pos + 1] = values[module];
+	}
+
+	const struct spi_buf tx_buf = {.buf = tx, .len = sizeof(tx)};
+	const struct spi_buf_set tx_bufs = {.buffers = &tx_buf, .count = 1};
+
+	return spi_write_dt(&max7219_spi, &tx_bufs);
+}
+
+static int set_modules_shutdown(const bool shutdown)
+{
+	uint8_t values[NUMBER_OF_MODULES];
+	memset(values, shutdown ? 0 : 1, sizeof(values));
+	return write_modules_register(MAX7219_REG_SHUTDOWN, values);
+}
+
+/* Apply the requested intensities scaled by step / max_step */
+static void apply_scaled_intensity(const uint8_t intensity[NUMBER_OF_MODULES], const int step,
+				   const int max_step)
+{
+	uint8_t values[NUMBER_OF_MODULES];
+
+	for (int module = 0; module < NUMBER_OF_MODULES; ++module) {
+		values[module] = max_step > 0 ? intensity[module] * step / max_step : 0;
+	}
+
+	if (write_modules_register(MAX7219_REG_INTENSITY, values) != 0) {
+		LOG_ERR("failed to write intensity");
+	}
+}
+
+static inline int get_max_intensity(const uint8_t intensity[NUMBER_OF_MODULES])
+{
+	int max = 0;
+	for (int module = 0; module < NUMBER_OF_MODULES; ++module) {
+		max = MAX(max, intensity[module]);
+	}
+	return max;
+}
 
-		if (event & GTP_DISPLAY_EVENT_SWITCH_MENU_MODE_ON) {
+/* The rendering is a state machine, each step runs to completion and returns
+ * the time till the next one. Steps run either on the display thread or as a
+ * work on the system workqueue with CONFIG_GTP_DISPLAY_WORKQUEUE. Requests are
+ * handled at the next step, except during fades which run to their end. */
+typedef enum {
+	RENDER_IDLE = 0,
+	RENDER_FADING_OUT,
+	RENDER_FADING_IN,
+	RENDER_SHIFT_START, // the beginning of the text is shown before shifting
+	RENDER_SHIFTING,
+	RENDER_SHIFT_END, // the end of the text is shown before starting again
+} render_state_e;
+
+static struct {
+	render_state_e state;
+	k_timepoint_t next_step;
+	text_cursor_t cursor;
+	int max_x;
+	bool shift_needed;
+	bool fade;
+	bool frame_is_blank;
+	int fade_step;
+	int fade_max_step;
+	uint8_t intensity[NUMBER_OF_MODULES];
+} render = {
+	.max_x = DISPLAY_WIDTH - 1,
+	.frame_is_blank = true,
+};
+
+static k_timeout_t schedule_step(const int ms)
+{
+	render.next_step = sys_timepoint_calc(K_MSEC(ms));
+	return K_MSEC(ms);
+}
+
+static inline bool render_is_fading()
+{
+	return render.state == RENDER_FADING_OUT || render.state == RENDER_FADING_IN;
+}
+
+static k_timeout_t start_text_shift()
+{
+	if (render.shift_needed) {
+		render.state = RENDER_SHIFT_START;
+		return schedule_step(SHIFT_START_DELAY_MS);
+	}
+
+	render.state = RENDER_IDLE;
+	return K_FOREVER;
+}
+
+static k_timeout_t render_text()
+{
+	k_mutex_lock(&gtp_display_mutex, K_FOREVER);
+	text_cursor_reset(&render.cursor, text);
+	render.frame_is_blank = *text == '\0';
+	render.max_x = max_x_display_area;
+	render.shift_needed = fill_text_area(&render.cursor, menu_mode, render.max_x);
+	k_mutex_unlock(&gtp_display_mutex);
+
+	display_write(display_dev, 0, 0, &buf_desc, buf);
+
+	if (render.fade) {
+		render.fade_max_step = get_max_intensity(render.intensity);
+		render.fade_step = 0;
+		apply_scaled_intensity(render.intensity, 0, render.fade_max_step);
+		set_modules_shutdown(false);
+
+		if (render.fade_max_step > 0) {
+			render.state = RENDER_FADING_IN;
+			return schedule_step(CONFIG_GTP_DISPLAY_FADE_STEP_MS);
+		}
+	}
+
+	return start_text_shift();
+}
+
+/* One intensity step per register value, the brightest module sets the
+ * number of steps, so a fade never costs more than 16 register writes. */
+static k_timeout_t fade_step()
+{
+	if (render.state == RENDER_FADING_OUT) {
+		if (render.fade_step > 0) {
+			--render.fade_step;
+			apply_scaled_intensity(render.intensity, render.fade_step,
+					       render.fade_max_step);
+			return schedule_step(CONFIG_GTP_DISPLAY_FADE_STEP_MS);
+		}
+
+		/* intensity 0 is still visible on MAX7219, shutdown the modules to
+		 * finish the fade out. */
+		set_modules_shutdown(true);
+		return render_text();
+	}
+
+	++render.fade_step;
+	apply_scaled_intensity(render.intensity, render.fade_step, render.fade_max_step);
+
+	if (render.fade_step < render.fade_max_step) {
+		return schedule_step(CONFIG_GTP_DISPLAY_FADE_STEP_MS);
+	}
+
+	return start_text_shift();
+}
+
+static k_timeout_t start_new_word()
+{
+	k_mutex_lock(&gtp_display_mutex, K_FOREVER);
+	render.fade = transition == GTP_DISPLAY_TRANSITION_FADE;
+	memcpy(render.intensity, module_intensity, sizeof(render.intensity));
+	k_mutex_unlock(&gtp_display_mutex);
+
+	if (render.fade && !render.frame_is_blank) {
+		render.state = RENDER_FADING_OUT;
+		render.fade_max_step = get_max_intensity(render.intensity);
+		render.fade_step = render.fade_max_step;
+		return fade_step();
+	}
+
+	return render_text();
+}
+
+/* The same text is shown again from its beginning, without any transition,
+ * only a new text, mode or intensity fades. */
+static k_timeout_t restart_text_shift()
+{
+	k_mutex_lock(&gtp_display_mutex, K_FOREVER);
+	text_cursor_reset(&render.cursor, text);
+	render.shift_needed = fill_text_area(&render.cursor, menu_mode, render.max_x);
+	k_mutex_unlock(&gtp_display_mutex);
+
+	display_write(display_dev, 0, 0, &buf_desc, buf);
+
+	return start_text_shift();
+}
+
+static k_timeout_t shift_step()
+{
+	uint8_t column = 0;
+
+	k_mutex_lock(&gtp_display_mutex, K_FOREVER);
+	const bool remaining = text_cursor_next_column(&render.cursor, &column);
+	k_mutex_unlock(&gtp_display_mutex);
+
+	if (!remaining) {
+		render.state = RENDER_SHIFT_END;
+		return schedule_step(SHIFT_END_DELAY_MS);
+	}
+
+	shift_in_column(column, render.max_x);
+	display_write(display_dev, 0, 0, &buf_desc, buf);
+
+	return schedule_step(SHIFT_STEP_MS);
+}
+
+static k_timeout_t render_step()
+{
+	if (render_is_fading()) {
+		if (!sys_timepoint_expired(render.next_step)) {
+			return sys_timepoint_timeout(render.next_step);
+		}
+		return fade_step();
+	}
+
+	uint32_t event;
+
+	while ((event = k_event_test(&gtp_display_event, GTP_DISPLAY_ALL_EVENTS_MASK)) != 0) {
+
+		if (event & GTP_DISPLAY_EVENT_INTENSITY) {
+			k_event_clear(&gtp_display_event, GTP_DISPLAY_EVENT_INTENSITY);
+
+			k_mutex_lock(&gtp_display_mutex, K_FOREVER);
+			memcpy(render.intensity, module_intensity, sizeof(render.intensity));
+			k_mutex_unlock(&gtp_display_mutex);
+
+			apply_scaled_intensity(render.intensity, 1, 1);
+
+		} else if (event & GTP_DISPLAY_EVENT_SWITCH_MENU_MODE_ON) {
 			LOG_INF("menu mode on");
 			gtp_display_set_min_max_display_area(0, DISPLAY_WIDTH_MENU_ON);
 			k_event_post(&gtp_display_event, GTP_DISPLAY_EVENT_NEW_WORD);
@@ -485,74 +854,59 @@ static void gtp_display_entry_point(void *, void *, void *)
 			k_event_clear(&gtp_display_event, GTP_DISPLAY_EVENT_SWITCH_MENU_MODE_OFF);
 
 		} else if (event & GTP_DISPLAY_EVENT_NEW_WORD) {
-			k_event_clear(&gtp_display_event, GTP_DISPLAY_EVENT_SHIFT_TEXT);
 			k_event_clear(&gtp_display_event, GTP_DISPLAY_EVENT_NEW_WORD);
+			start_new_word();
 
-			k_mutex_lock(&gtp_display_mutex, K_FOREVER);
-			strlcpy(local_sentence, sentence, sizeof(local_sentence));
-			RESET_VARIABLES();
-			local_menu_mode = menu_mode;
-			local_max_x_display = max_x_display_area;
-			local_shift_needed =
-				total_dot_led_length > local_max_x_display ? true : false;
-			k_mutex_unlock(&gtp_display_mutex);
-
-			add_sentence(global_offset, local_sentence, local_max_x_display);
-
-			add_menu_mode_arrows(local_menu_mode);
-			display_write(display_dev, 0, 0, &buf_desc, buf);
-
-			if (local_shift_needed) {
-				INTERRUPTIBLE_SLEEP(500);
-				k_event_post(&gtp_display_event, GTP_DISPLAY_EVENT_SHIFT_TEXT);
+			/* requests made during the fade wait for its end */
+			if (render_is_fading()) {
+				return sys_timepoint_timeout(render.next_step);
 			}
+		}
+	}
 
-		} else if (event & GTP_DISPLAY_EVENT_SHIFT_TEXT) {
-			global_offset--;
-			INTERRUPTIBLE_SLEEP(50);
-
-			memset(buf, 0, sizeof(buf));
-			idx = global_offset;
-
-			for (const char *c = local_sentence; *c != '\0'; ++c) {
-				if (*c < ASCII_OFFSET ||
-				    *c >= (ASCII_OFFSET + sizeof(symbols) / sizeof(symbols[0]))) {
-					LOG_WRN("Character '%c' not valid", *c);
-					continue;
-				}
-
-				const display_symbol_t *symbol =
-					symbols_lookup_table[*c - ASCII_OFFSET];
-				if (symbol) {
-					// LOG_INF("add char %c at idx %d", *c, idx);
-					gtp_display_add_letter(symbol->mask, &idx,
-							       local_max_x_display);
-					idx += symbol->width;
-					idx += 1; // space between symbol
-				} else {
-					LOG_ERR("Character not found in lookup table: %c", *c);
-				}
-			}
+	if (render.state == RENDER_IDLE) {
+		return K_FOREVER;
+	}
 
-			// add up and down arrows if in menu mode
-			if (local_menu_mode == true) {
-				int tmp_idx = 24;
-				gtp_display_add_letter(up_arrow_mask, &tmp_idx, DISPLAY_WIDTH);
-				tmp_idx = 24;
-				gtp_display_add_letter(down_arrow_mask, &tmp_idx, DISPLAY_WIDTH);
-			}
+	if (!sys_timepoint_expired(render.next_step)) {
+		return sys_timepoint_timeout(render.next_step);
+	}
 
-			display_write(display_dev, 0, 0, &buf_desc, buf);
+	switch (render.state) {
+	case RENDER_SHIFT_START:
+		render.state = RENDER_SHIFTING;
+		return schedule_step(SHIFT_STEP_MS);
+	case RENDER_SHIFTING:
+		return shift_step();
+	case RENDER_SHIFT_END:
+		return restart_text_shift();
+	default:
+		return K_FOREVER;
+	}
+}
 
-			/* detect if end of shifting */
-			if (total_dot_led_length + global_offset <= local_max_x_display) {
-				INTERRUPTIBLE_SLEEP(1000);
-				k_event_clear(&gtp_display_event, GTP_DISPLAY_EVENT_SHIFT_TEXT);
-				k_event_post(&gtp_display_event, GTP_DISPLAY_EVENT_NEW_WORD);
-			}
+#if defined(CONFIG_GTP_DISPLAY_WORKQUEUE)
+static void display_work_handler(struct k_work *work)
+{
+	const k_timeout_t timeout = render_step();
 
+	/* a request made meanwhile has already queued the work again */
+	if (!K_TIMEOUT_EQ(timeout, K_FOREVER)) {
+		k_work_schedule(&display_work, timeout);
+	}
+}
+#else
+static void gtp_display_entry_point(void *, void *, void *)
+{
+	k_timeout_t timeout = K_FOREVER;
+
+	while (1) {
+		if (render_is_fading()) {
+			k_sleep(timeout);
 		} else {
-			LOG_WRN("unknown event: %d", event);
+			k_event_wait(&gtp_display_event, GTP_DISPLAY_ALL_EVENTS_MASK, false, timeout);
 		}
+		timeout = render_step();
 	}
 }
+#endif
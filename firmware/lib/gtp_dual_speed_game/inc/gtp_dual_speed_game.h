@@ -1,9 +0,0 @@
-#ifndef GTP_DUAL_SPEED_GAME_H__
-#define GTP_DUAL_SPEED_GAME_H__
-
-void gtp_dual_speed_game_init();
-const char *gtp_dual_speed_game_get_menu_title();
-void gtp_dual_speed_game_start();
-int gtp_dual_speed_game_play();
-
-#endif /* GTP_DUAL_SPEED_GAME_H__ */
@@ -0,0 +1,16 @@
+#ifndef GTP_DUAL_SPEED_GAME_STATE_H__
+#define GTP_DUAL_SPEED_GAME_STATE_H__
+
+#include <gtp_display.h>
+#include <gtp_game.h>
+
+#define MAX_ROW 8
+
+typedef struct {
+	uint8_t buf[DISPLAY_WIDTH];
+	uint8_t now_row;
+	uint8_t left_player_idx[MAX_ROW];
+	uint8_t right_player_idx[MAX_ROW];
+} dual_speed_game_state_t;
+
+#endif /* GTP_DUAL_SPEED_GAME_STATE_H__ */
@@ -11,22 +11,102 @@
 #ifndef GTP_GAME_H__
 #define GTP_GAME_H__
 
+#include <zephyr/kernel.h>
+#include <zephyr/toolchain.h>
 #include <zephyr/types.h>
+#include <zephyr/sys/iterable_sections.h>
 #include <stdbool.h>
+#include <stddef.h>
 
-typedef struct {
-	void (*start)(void);
+typedef int (*gtp_game_play_func_t)(void);
+
+/* A menu entry, games and songs register one with GTP_GAME_DEFINE(). init is
+ * called at boot and stop before the next game starts, both may be NULL.
+ * ram_size is the size of the game state in the arena, 0 without one. */
+typedef struct gtp_game_api {
+	const char *title;
+	void (*init)(void);
+	gtp_game_play_func_t play;
 	void (*stop)(void);
+	size_t ram_size;
 } gtp_game_api_t;
 
-uint8_t *gtp_game_get_random_suite_ptr();
+/* Entries are placed in an iterable section at link time, the menu lists them
+ * by order, a two digits number, then by name. */
+#define GTP_GAME_DEFINE(order, name, _title, _init, _play, _stop, _ram_size)                      \
+	STRUCT_SECTION_ITERABLE(gtp_game_api, gtp_game_##order##_##name) = {                      \
+		.title = _title,                                                                   \
+		.init = _init,                                                                     \
+		.play = _play,                                                                     \
+		.stop = _stop,                                                                     \
+		.ram_size = _ram_size,                                                             \
+	}
+
+/* Only one game plays at a time, so games keep their state in an arena they
+ * all share instead of static variables. GTP_GAME_STATE_DEFINE() gives the
+ * state of the game of the file as the name pointer, the state type must be
+ * added to the arena with gtp_game_add_state() in the game CMakeLists.txt,
+ * the arena is sized to the largest state added. The first ram_size bytes of
+ * the arena are zeroed before the game plays, ram_size being sizeof(*name).
+ * The state is lost once another game starts. */
+extern uint8_t gtp_game_arena[];
+
+#define GTP_GAME_STATE_DEFINE(type, name) static type *const name = (type *)gtp_game_arena
+
+int gtp_game_count();
+const gtp_game_api_t *gtp_game_get(const int idx);
+
 void gtp_game_init();
 void gtp_game_countdown_to_play();
-void gtp_game_init_random_button_suite();
 void gtp_game_display_score_int64(const int64_t score);
 void gtp_game_display_score_int32(const int score);
 void gtp_game_display_score_int64_millisec(const int64_t score);
-void gtp_game_wait_for_any_input(bool *boolean);
+void gtp_game_sleep_ms(const int ms);
+
+/* Random streams, xoshiro128** generators of 16 bytes. Each game keeps its
+ * own, a stream seeded again replays the same numbers. Seeds are taken from
+ * the random generator unless CONFIG_GTP_GAME_RANDOM_SEED is set. */
+typedef struct {
+	uint32_t s[4];
+} gtp_game_rand_t;
+
+/* Returns the seed used, to be given to gtp_game_rand_seed() to replay. */
+uint32_t gtp_game_rand_init(gtp_game_rand_t *rng);
+void gtp_game_rand_seed(gtp_game_rand_t *rng, const uint32_t seed);
+uint32_t gtp_game_rand_next(gtp_game_rand_t *rng);
+
+/* Unbiased number in [0, bound), 0 when bound is 0. */
+uint32_t gtp_game_rand_range(gtp_game_rand_t *rng, const uint32_t bound);
+
+/* Game events are bits a game defines for itself, posted from the button
+ * callbacks or from any other context, interrupts included. All of them are
+ * cleared when a game starts. The waits below keep processing the button
+ * events, so the game callbacks are called while the game thread sleeps.
+ * The last bit is kept for gtp_game_wait_for_any_input. */
+#define GTP_GAME_ANY_INPUT_EVENT BIT(31)
+void gtp_game_post_events(const uint32_t events);
+void gtp_game_clear_events(const uint32_t events);
+
+/* Waits for any of the events, or for all of them when all is true, and clears
+ * the ones returned. Returns 0 on timeout. */
+uint32_t gtp_game_wait_events(const uint32_t events, const bool all, k_timeout_t timeout);
+
+/* Waits for count button events to be processed, returns the number processed
+ * before the timeout. */
+int gtp_game_wait_for_inputs(const int count, k_timeout_t timeout);
+
+/* Drops the pending button events and waits for the next press, the game
+ * callback is replaced so this ends the game, e.g. on the score screen. */
+void gtp_game_wait_for_any_input();
+
+/* Games are started from the menu callbacks, they run on the thread of the
+ * dispatcher, which waits on both the button events and the start requests.
+ * A request made while another one is pending is dropped with -ENOMSG.
+ * on_finished is called with the play result once the game is over. */
+typedef void (*gtp_game_finished_cb_t)(const int result);
+
+int gtp_game_request_start(const gtp_game_api_t *game);
+FUNC_NORETURN void gtp_game_run_dispatcher(gtp_game_finished_cb_t on_finished);
 
 #define GAME_WELL_FINISHED 1
 #define SONG_WELL_FINISHED GAME_WELL_FINISHED
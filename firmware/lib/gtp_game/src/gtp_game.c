@@ -4,22 +4,52 @@
 #include <zephyr/random/random.h>
 #include <gtp_buttons.h>
 #include <string.h>
+#include <gtp_game_arena.h>
 
 #include <zephyr/logging/log.h>
 LOG_MODULE_REGISTER(gtp_game, CONFIG_GTPGAME_LOG_LEVEL);
 
-#define RANDOM_SUITE_MAX_LEN 50
+K_MSGQ_DEFINE(game_start_msgq, sizeof(const gtp_game_api_t *), 1, 4);
+
+/* k_event objects cannot be polled, the signal wakes up the waiting game
+ * along with the button events. */
+K_EVENT_DEFINE(game_events);
+static struct k_poll_signal game_events_signal = K_POLL_SIGNAL_INITIALIZER(game_events_signal);
+
+/* the union of the game states, see gtp_game_add_state() */
+uint8_t gtp_game_arena[sizeof(union gtp_game_states)] __aligned(__alignof__(union gtp_game_states));
 
 static char fss[32] = {0};
-static uint8_t random_suite[RANDOM_SUITE_MAX_LEN];
 
-uint8_t *gtp_game_get_random_suite_ptr()
+void gtp_game_init()
 {
-	return random_suite;
+	STRUCT_SECTION_FOREACH(gtp_game_api, game) {
+		if (game->init != NULL) {
+			game->init();
+		}
+		if (game->ram_size > sizeof(gtp_game_arena)) {
+			LOG_ERR("%s: state of %zu bytes not added to the game arena", game->title,
+				game->ram_size);
+		}
+	}
+
+	LOG_INF("%d games, %zu bytes of game arena", gtp_game_count(), sizeof(gtp_game_arena));
 }
 
-void gtp_game_init()
+int gtp_game_count()
 {
+	int count;
+
+	STRUCT_SECTION_COUNT(gtp_game_api, &count);
+	return count;
+}
+
+const gtp_game_api_t *gtp_game_get(const int idx)
+{
+	gtp_game_api_t *game;
+
+	STRUCT_SECTION_GET(gtp_game_api, idx, &game);
+	return game;
 }
 
 void gtp_game_countdown_to_play()
@@ -41,14 +71,69 @@ void gtp_game_countdown_to_play()
 	k_msleep(1000);
 }
 
-void gtp_game_init_random_button_suite()
+uint32_t gtp_game_rand_init(gtp_game_rand_t *rng)
+{
+	const uint32_t seed =
+		CONFIG_GTP_GAME_RANDOM_SEED != 0 ? CONFIG_GTP_GAME_RANDOM_SEED : sys_rand32_get();
+
+	gtp_game_rand_seed(rng, seed);
+	LOG_DBG("random seed 0x%08x", seed);
+
+	return seed;
+}
+
+/* The state is filled with splitmix32, which never gives 4 zero words for
+ * consecutive inputs, the only state xoshiro cannot leave. */
+void gtp_game_rand_seed(gtp_game_rand_t *rng, const uint32_t seed)
+{
+	uint32_t x = seed;
+
+	for (int i = 0; i < ARRAY_SIZE(rng->s); ++i) {
+		x += 0x9E3779B9u;
+		uint32_t z = x;
+		z = (z ^ (z >> 16)) * 0x85EBCA6Bu;
+		z = (z ^ (z >> 13)) * 0xC2B2AE35u;
+		rng->s[i] = z ^ (z >> 16);
+	}
+}
+
+static inline uint32_t rotl(const uint32_t x, const int k)
+{
+	return (x << k) | (x >> (32 - k));
+}
+
+uint32_t gtp_game_rand_next(gtp_game_rand_t *rng)
 {
-	sys_rand_get(random_suite, sizeof(random_suite));
+	uint32_t *s = rng->s;
+	const uint32_t result = rotl(s[1] * 5, 7) * 9;
+	const uint32_t t = s[1] << 9;
 
-	for (int i = 0; i < RANDOM_SUITE_MAX_LEN; ++i) {
-		random_suite[i] *= random_suite[i] < 0 ? -1 : 1;
-		random_suite[i] = random_suite[i] % NUMBER_OF_BUTTONS;
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = rotl(s[3], 11);
+
+	return result;
+}
+
+/* The cortex-M0 has no divider, numbers are masked to the next power of two
+ * and drawn again when out of range, less than twice on average. */
+uint32_t gtp_game_rand_range(gtp_game_rand_t *rng, const uint32_t bound)
+{
+	if (bound <= 1) {
+		return 0;
 	}
+
+	const uint32_t mask = UINT32_MAX >> __builtin_clz(bound - 1);
+	uint32_t value;
+
+	do {
+		value = gtp_game_rand_next(rng) & mask;
+	} while (value >= bound);
+
+	return value;
 }
 
 void gtp_game_display_score_int64(const int64_t score)
@@ -69,10 +154,133 @@ void gtp_game_display_score_int64_millisec(const int64_t score)
 	gtp_display_print_sentence(fss, strlen(fss));
 }
 
-void gtp_game_wait_for_any_input(bool *boolean)
+void gtp_game_post_events(const uint32_t events)
+{
+	k_event_post(&game_events, events);
+	k_poll_signal_raise(&game_events_signal, 0);
+}
+
+void gtp_game_clear_events(const uint32_t events)
 {
-	*boolean = true;
-	while (*boolean) {
-		k_msleep(10);
+	k_event_clear(&game_events, events);
+}
+
+uint32_t gtp_game_wait_events(const uint32_t events, const bool all, k_timeout_t timeout)
+{
+	const k_timepoint_t end = sys_timepoint_calc(timeout);
+	struct k_poll_event poll_events[2];
+
+	gtp_buttons_init_poll_event(&poll_events[0]);
+	k_poll_event_init(&poll_events[1], K_POLL_TYPE_SIGNAL, K_POLL_MODE_NOTIFY_ONLY,
+			  &game_events_signal);
+
+	while (1) {
+		/* reset before testing, an event posted after the test raises the
+		 * signal again and k_poll returns at once */
+		k_poll_signal_reset(&game_events_signal);
+
+		/* button callbacks may post the events */
+		gtp_buttons_process_events(K_NO_WAIT);
+
+		const uint32_t matched = k_event_test(&game_events, events);
+
+		if ((all && matched == events) || (!all && matched != 0)) {
+			k_event_clear(&game_events, matched);
+			return matched;
+		}
+
+		if (k_poll(poll_events, ARRAY_SIZE(poll_events), sys_timepoint_timeout(end)) != 0) {
+			return 0;
+		}
+		poll_events[0].state = K_POLL_STATE_NOT_READY;
+		poll_events[1].state = K_POLL_STATE_NOT_READY;
+	}
+}
+
+int gtp_game_wait_for_inputs(const int count, k_timeout_t timeout)
+{
+	const k_timepoint_t end = sys_timepoint_calc(timeout);
+	int processed = 0;
+
+	while (processed < count) {
+		const int n = gtp_buttons_process_events(sys_timepoint_timeout(end));
+
+		if (n == 0) {
+			break;
+		}
+		processed += n;
+	}
+
+	return processed;
+}
+
+static void on_any_input(const gtp_buttons_event_t *evt)
+{
+	if (evt->event == GTP_BUTTON_EVENT_PRESSED) {
+		gtp_game_post_events(GTP_GAME_ANY_INPUT_EVENT);
+	}
+}
+
+/* Queued events, such as the release of the last button of the game, and the
+ * releases or gestures coming after it must not end the wait, only a new press
+ * does. */
+void gtp_game_wait_for_any_input()
+{
+	gtp_buttons_set_timed_cb(on_any_input);
+	gtp_buttons_flush_events();
+	gtp_game_clear_events(GTP_GAME_ANY_INPUT_EVENT);
+	gtp_game_wait_events(GTP_GAME_ANY_INPUT_EVENT, false, K_FOREVER);
+}
+
+/* Button callbacks are called from the game thread, a game must keep
+ * processing button events while it waits. */
+void gtp_game_sleep_ms(const int ms)
+{
+	const k_timepoint_t end = sys_timepoint_calc(K_MSEC(ms));
+
+	while (!sys_timepoint_expired(end)) {
+		gtp_buttons_process_events(sys_timepoint_timeout(end));
+	}
+}
+
+int gtp_game_request_start(const gtp_game_api_t *game)
+{
+	return k_msgq_put(&game_start_msgq, &game, K_NO_WAIT);
+}
+
+void gtp_game_run_dispatcher(gtp_game_finished_cb_t on_finished)
+{
+	struct k_poll_event events[2];
+	const gtp_game_api_t *game;
+	const gtp_game_api_t *last_game = NULL;
+
+	gtp_buttons_init_poll_event(&events[0]);
+	k_poll_event_init(&events[1], K_POLL_TYPE_MSGQ_DATA_AVAILABLE, K_POLL_MODE_NOTIFY_ONLY,
+			  &game_start_msgq);
+
+	while (1) {
+		k_poll(events, ARRAY_SIZE(events), K_FOREVER);
+		events[0].state = K_POLL_STATE_NOT_READY;
+		events[1].state = K_POLL_STATE_NOT_READY;
+
+		/* menu callbacks are called from here, they may request a game */
+		gtp_buttons_process_events(K_NO_WAIT);
+
+		if (k_msgq_get(&game_start_msgq, &game, K_NO_WAIT) == 0) {
+			/* a song may still be playing in the background */
+			if (last_game != NULL && last_game->stop != NULL) {
+				last_game->stop();
+			}
+			last_game = game;
+			k_event_set(&game_events, 0);
+			__ASSERT_NO_MSG(game->ram_size <= sizeof(gtp_game_arena));
+			memset(gtp_game_arena, 0, game->ram_size);
+
+			const int result = game->play();
+
+			if (on_finished != NULL) {
+				on_finished(result);
+			}
+		}
 	}
 }
@@ -1,9 +0,0 @@
-#ifndef GTP_MEMORY_GAME_H__
-#define GTP_MEMORY_GAME_H__
-
-void gtp_memory_game_init();
-const char *gtp_memory_game_get_menu_title();
-void gtp_memory_game_start();
-int gtp_memory_game_play();
-
-#endif /* GTP_MEMORY_GAME_H__ */
@@ -0,0 +1,16 @@
+#ifndef GTP_MEMORY_GAME_STATE_H__
+#define GTP_MEMORY_GAME_STATE_H__
+
+#include <gtp_game.h>
+
+/* the sequence is drawn again from its seed at each round, expected_color is
+ * the next color of the sequence the player has to press */
+typedef struct {
+	int round_idx;
+	int move_idx;
+	uint32_t sequence_seed;
+	gtp_game_rand_t sequence_rng;
+	uint8_t expected_color;
+} memory_game_state_t;
+
+#endif /* GTP_MEMORY_GAME_STATE_H__ */
@@ -1,30 +1,21 @@
 #include <gtp_menu.h>
+#include <gtp_game.h>
 
 #include <zephyr/logging/log.h>
 LOG_MODULE_REGISTER(gtp_menu, CONFIG_GTPMENU_LOG_LEVEL);
 
-#define MAX_MENU_NUMBER 10
-
+/* the menu lists the games registered with GTP_GAME_DEFINE() */
 static int8_t menu_index = 0;
-static int8_t init_menu_index = 0;
 static int8_t init_max_menu_index = 0;
 
 static bool menu_mode_enabled = true;
 static on_gtp_menu_event_cb_t on_gtp_menu_event_cb = NULL;
 
-typedef struct {
-	const char *menu_name;
-	start_game_func_t start_function;
-} menu_t;
-
-static menu_t menus[MAX_MENU_NUMBER] = {NULL};
-
 void gtp_menu_init()
 {
 	menu_index = 0;
 	menu_mode_enabled = true;
-	init_menu_index = 0;
-	init_max_menu_index = 0;
+	init_max_menu_index = gtp_game_count();
 }
 
 void gtp_menu_next()
@@ -54,29 +45,20 @@ bool gtp_menu_is_menu_mode()
 	return menu_mode_enabled;
 }
 
-void gtp_menu_set_title(const char *title, start_game_func_t start_func)
+void gtp_menu_start_current_game()
 {
-	if (init_menu_index >= MAX_MENU_NUMBER) {
-		LOG_ERR("menu index out of range");
+	if (init_max_menu_index <= 0) {
 		return;
 	}
-	menus[init_menu_index].menu_name = title;
-	menus[init_menu_index].start_function = start_func;
-	init_menu_index++;
-	init_max_menu_index++;
-}
-
-void gtp_menu_start_current_game()
-{
-	if (menus[menu_index].start_function != NULL) {
-		menus[menu_index].start_function();
+	if (gtp_game_request_start(gtp_game_get(menu_index)) != 0) {
+		LOG_ERR("a game is already starting");
 	}
 }
 
 void gtp_menu_raise_cb()
 {
-	if (on_gtp_menu_event_cb != NULL) {
-		on_gtp_menu_event_cb(menus[menu_index].menu_name);
+	if (on_gtp_menu_event_cb != NULL && init_max_menu_index > 0) {
+		on_gtp_menu_event_cb(gtp_game_get(menu_index)->title);
 	}
 }
 
@@ -0,0 +1,30 @@
+#ifndef GTP_REACTIVITY_GAME_STATE_H__
+#define GTP_REACTIVITY_GAME_STATE_H__
+
+#include <gtp_game.h>
+
+#define NUMBER_OF_ROUND 10
+
+/* start and end are buttons timestamps, taken when the color is shown
+ * and in the interrupt of the player press. */
+typedef struct {
+	uint32_t start;
+	uint32_t end;
+} round_timing_t;
+
+typedef enum {
+	REACTIVITY_GAME_NORMAL = 0,
+	REACTIVITY_GAME_INVERTED = 1,
+	REACTIVITY_GAME_PHRASE = 2
+} reactivity_game_mode_t;
+
+typedef struct {
+	reactivity_game_mode_t game_mode;
+	round_timing_t round_timings[NUMBER_OF_ROUND];
+	uint32_t penalty_time_ms;
+	int round;
+	gtp_game_rand_t rng;
+	uint8_t round_color;
+} reactivity_game_state_t;
+
+#endif /* GTP_REACTIVITY_GAME_STATE_H__ */
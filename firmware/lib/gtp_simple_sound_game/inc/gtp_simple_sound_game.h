@@ -1,9 +0,0 @@
-#ifndef GTP_SIMPLE_SOUND_GAME_H__
-#define GTP_SIMPLE_SOUND_GAME_H__
-
-void gtp_simple_sound_game_init();
-const char *gtp_simple_sound_game_get_menu_title();
-void gtp_simple_sound_game_start();
-int gtp_simple_sound_game_play();
-
-#endif // GTP_SIMPLE_SOUND_GAME_H__
@@ -1,10 +1,10 @@
 #include <gtp_game.h>
-#include <gtp_simple_sound_game.h>
 #include <gtp_buttons.h>
 #include <gtp_display.h>
 #include <gtp_sound.h>
 #include <string.h>
 #include <zephyr/kernel.h>
+#include "gtp_simple_sound_game_state.h"
 
 #include <zephyr/logging/log.h>
 LOG_MODULE_REGISTER(gtp_simple_sound_game, CONFIG_GTPSIMPLESOUNDGAME_LOG_LEVEL);
@@ -13,88 +13,82 @@ LOG_MODULE_REGISTER(gtp_simple_sound_game, CONFIG_GTPSIMPLESOUNDGAME_LOG_LEVEL);
 
 static const struct pwm_dt_spec pwm_led0 = PWM_DT_SPEC_GET(DT_ALIAS(pwmled0));
 
-K_SEM_DEFINE(simple_sound_game_start, 0, 1);
-
 static const char menu_title[] = "simple sound game";
-static bool game_is_finished = false;
-
-static void on_gtp_buttons_event_cb(const gtp_buttons_color_e color, const gtp_button_event_e event)
-{
-	if (event == GTP_BUTTON_EVENT_PRESSED) {
-
-		gtp_buttons_set_led(color, GTP_BUTTON_STATUS_ON);
-
-		switch (color) {
-		case GTP_BUTTON_RED_COLOR:
-			gtp_game_sound_play_note(NOTE_FS5, 999999);
-			break;
 
-		case GTP_BUTTON_BLUE_COLOR:
-			gtp_game_sound_play_note(NOTE_D6, 999999);
-			break;
+#define GAME_FINISHED_EVENT BIT(0)
 
-		case GTP_BUTTON_GREEN_COLOR:
-			gtp_game_sound_play_note(NOTE_E6, 999999);
-			break;
+static const uint16_t button_notes[NUMBER_OF_BUTTONS] = {
+	[GTP_BUTTON_RED_COLOR] = NOTE_FS5,
+	[GTP_BUTTON_BLUE_COLOR] = NOTE_D6,
+	[GTP_BUTTON_GREEN_COLOR] = NOTE_E6,
+	[GTP_BUTTON_YELLOW_COLOR] = NOTE_G6,
+	[GTP_BUTTON_WHITE_COLOR] = NOTE_B6,
+};
 
-		case GTP_BUTTON_YELLOW_COLOR:
-			gtp_game_sound_play_note(NOTE_G6, 999999);
-			break;
+GTP_GAME_STATE_DEFINE(simple_sound_game_state_t, game);
 
-		case GTP_BUTTON_WHITE_COLOR:
-			gtp_game_sound_play_note(NOTE_B6, 999999);
-			break;
+/* The buttons held play together as a chord, the lowest colors first when
+ * more than GTP_SOUND_MAX_VOICES are held. */
+static void play_held_buttons()
+{
+	uint16_t notes[GTP_SOUND_MAX_VOICES];
+	int count = 0;
 
-		default:
-			break;
+	for (int i = 0; i < NUMBER_OF_BUTTONS && count < ARRAY_SIZE(notes); ++i) {
+		if (game->held & BIT(i)) {
+			notes[count++] = button_notes[i];
 		}
-	} else if (event == GTP_BUTTON_EVENT_RELEASED) {
-		gtp_buttons_set_led(color, GTP_BUTTON_STATUS_OFF);
-		gtp_game_sound_rest();
 	}
 
-	if (gtp_buttons_is_all_pressed()) {
-		game_is_finished = true;
+	if (count == 0) {
 		gtp_game_sound_rest();
+	} else if (count == 1) {
+		gtp_game_sound_play_note(notes[0], GTP_SOUND_FOREVER);
+	} else {
+		gtp_sound_play_chord(notes, count, GTP_SOUND_FOREVER);
 	}
 }
 
-void gtp_simple_sound_game_init()
+static void on_gtp_buttons_event_cb(const gtp_buttons_event_t *evt)
 {
-	k_sem_take(&simple_sound_game_start, K_NO_WAIT);
-}
+	const gtp_buttons_color_e color = evt->color;
+	const gtp_button_event_e event = evt->event;
 
-const char *gtp_simple_sound_game_get_menu_title()
-{
-	return menu_title;
-}
+	if (event == GTP_BUTTON_EVENT_PRESSED) {
+		game->held |= BIT(color);
+		gtp_buttons_set_led(color, GTP_BUTTON_STATUS_ON);
+		play_held_buttons();
 
-void gtp_simple_sound_game_start()
-{
-	k_sem_give(&simple_sound_game_start);
-}
+	} else if (event == GTP_BUTTON_EVENT_RELEASED) {
+		game->held &= ~BIT(color);
+		gtp_buttons_set_led(color, GTP_BUTTON_STATUS_OFF);
+		/* the buttons still held keep playing */
+		play_held_buttons();
 
-int gtp_simple_sound_game_play()
-{
-	if (k_sem_take(&simple_sound_game_start, K_NO_WAIT) != 0) {
-		return 0;
+	} else if (event == GTP_BUTTON_EVENT_CHORD &&
+		   evt->buttons == BIT_MASK(NUMBER_OF_BUTTONS)) {
+		/* all the buttons pressed together ends the game */
+		gtp_game_post_events(GAME_FINISHED_EVENT);
+		gtp_game_sound_rest();
 	}
+}
 
+static int gtp_simple_sound_game_play()
+{
 	if (!pwm_is_ready_dt(&pwm_led0)) {
 		printk("Error: PWM device %s is not ready\n", pwm_led0.dev->name);
 		return 0;
 	}
 
 	static const char *title = "play music";
-	gtp_display_print_sentence(title, strlen(title));
+	gtp_display_print_const_sentence(title);
 
-	gtp_buttons_set_cb(on_gtp_buttons_event_cb);
+	gtp_buttons_set_timed_cb(on_gtp_buttons_event_cb);
 
-	game_is_finished = false;
-
-	while (game_is_finished == false) {
-		k_msleep(100);
-	}
+	gtp_game_wait_events(GAME_FINISHED_EVENT, false, K_FOREVER);
 
 	return GAME_WELL_FINISHED;
 }
+
+GTP_GAME_DEFINE(20, simple_sound_game, menu_title, NULL, gtp_simple_sound_game_play, NULL,
+		sizeof(*game));
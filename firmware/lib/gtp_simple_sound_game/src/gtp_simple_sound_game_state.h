@@ -0,0 +1,10 @@
+#ifndef GTP_SIMPLE_SOUND_GAME_STATE_H__
+#define GTP_SIMPLE_SOUND_GAME_STATE_H__
+
+#include <gtp_game.h>
+
+typedef struct {
+	uint8_t held; // bit n is the button of color n
+} simple_sound_game_state_t;
+
+#endif /* GTP_SIMPLE_SOUND_GAME_STATE_H__ */
@@ -2,6 +2,7 @@
 #define GTP_SOUND_H__
 
 #include <zephyr/types.h>
+#include <stdbool.h>
 
 /* 740 is to be the lowest frequency that can be used
  * for this hardware. */
@@ -49,15 +50,93 @@ void gtp_sound_good_short_bip();
 void gtp_sound_good_long_bip();
 void gtp_sound_error_long_bip();
 
-const char *gtp_sound_tell_it_on_the_mountain_get_menu_title();
-int gtp_sound_play_tell_it_on_the_mountain();
-void gtp_sound_tell_it_on_the_mountain_start();
-
-const char *gtp_sound_merry_christmas_get_menu_title();
-int gtp_sound_play_merry_christmas();
-void gtp_sound_a_merry_christmas_start();
+/* Notes can be played from any context, a new note replaces the current one.
+ * Durations are in ms, up to 32s, GTP_SOUND_FOREVER plays till the next note
+ * or rest. Notes are NOTE_* frequencies, others play as the closest one. */
+#define GTP_SOUND_FOREVER -1
 
 void gtp_game_sound_play_note(const uint16_t note, const int duration_ms);
 void gtp_game_sound_rest();
 
+/* Chords are arpeggiated, the buzzer switches between the notes every
+ * CONFIG_GTP_SOUND_ARPEGGIO_PERIOD_MS. Notes past GTP_SOUND_MAX_VOICES are
+ * ignored, durations are rounded up to 4ms. */
+#define GTP_SOUND_MAX_VOICES 3
+
+void gtp_sound_play_chord(const uint16_t *notes, const int count, const int duration_ms);
+
+/* Stops the note only if it is still the one playing. */
+void gtp_sound_note_off(const uint16_t note);
+
+/* Sound effects play over the notes and songs, which go on silently and are
+ * heard again when the effect ends. An effect does not replace another one of
+ * higher priority still playing. */
+#define GTP_SOUND_SFX_PRIORITY_LOW    1
+#define GTP_SOUND_SFX_PRIORITY_NORMAL 2
+#define GTP_SOUND_SFX_PRIORITY_HIGH   3
+
+void gtp_sound_play_sfx(const uint16_t note, const int duration_ms, const uint16_t priority);
+
+/* Songs are stored packed in flash, 1 byte per note and 2 when the note does
+ * not use the song default duration:
+ *   bits 0-5: note, an index in GTP_SOUND_NOTES() starting at 1, 0 is a rest
+ *   bit 6:    legato, no gap after the note
+ *   bit 7:    the next byte is the note duration in ticks
+ * Index 63 is kept for the control codes: a section start, the repeat of the
+ * last section, the end of the song and a note added to the next one to make
+ * a chord of up to GTP_SOUND_MAX_VOICES notes. Sections do not nest. Write songs with
+ * the SONG_* macros below, or drop an RTTTL or MIDI file in songs/ to have it
+ * generated by scripts/gen_songs.py, which also reads this note list. */
+#define GTP_SOUND_NOTES(X)                                                                         \
+	X(FS5) X(G5) X(GS5) X(A5) X(AS5) X(B5) X(C6) X(CS6) X(D6) X(DS6) X(E6) X(F6) X(FS6)       \
+	X(G6) X(GS6) X(A6) X(AS6) X(B6) X(C7) X(CS7) X(D7) X(DS7) X(E7) X(F7) X(FS7) X(G7)        \
+	X(GS7) X(A7) X(AS7) X(B7) X(C8) X(CS8) X(D8) X(DS8)
+
+#define SONG_IDX_ENTRY(note) SONG_IDX_##note,
+
+enum song_note_idx_e {
+	SONG_IDX_REST = 0,
+	GTP_SOUND_NOTES(SONG_IDX_ENTRY) SONG_IDX_COUNT
+};
+
+#define SONG_IDX_MASK     0x3Fu
+#define SONG_LEGATO_FLAG  0x40u
+#define SONG_TICKS_FOLLOW 0x80u
+#define SONG_CONTROL      SONG_IDX_MASK
+
+#define SONG_NOTE(note)              (SONG_IDX_##note)
+#define SONG_NOTE_TICKS(note, ticks) (SONG_TICKS_FOLLOW | SONG_IDX_##note), (ticks)
+#define SONG_LEGATO(note)            (SONG_LEGATO_FLAG | SONG_IDX_##note)
+#define SONG_LEGATO_TICKS(note, ticks)                                                             \
+	(SONG_TICKS_FOLLOW | SONG_LEGATO_FLAG | SONG_IDX_##note), (ticks)
+#define SONG_SECTION       (SONG_CONTROL)
+#define SONG_END           (SONG_LEGATO_FLAG | SONG_CONTROL)
+#define SONG_REPEAT(times) (SONG_TICKS_FOLLOW | SONG_CONTROL), (times)
+#define SONG_WITH_CODE     (SONG_TICKS_FOLLOW | SONG_LEGATO_FLAG | SONG_CONTROL)
+#define SONG_WITH(note)    SONG_WITH_CODE, (SONG_IDX_##note)
+
+/* The song header, each note is followed by a silence of gap_ms unless legato.
+ * A tick of 50ms keeps durations up to 12s on a single byte. */
+typedef struct {
+	const uint8_t *notes;
+	uint16_t size;
+	uint8_t tick_ms;
+	uint8_t default_ticks;
+	uint8_t gap_ms;
+} gtp_sound_song_t;
+
+/* completed is false when the song has been stopped. Called from the timer
+ * interrupt when the song ends, keep it short. */
+typedef void (*gtp_sound_song_done_cb_t)(bool completed);
+
+/* Songs play in the background, starting a song stops the current one. The
+ * song must stay valid while it plays. The tempo is in percent of the written
+ * durations, 200 plays twice faster, it applies from the next note. */
+void gtp_sound_song_start(const gtp_sound_song_t *song, gtp_sound_song_done_cb_t done_cb);
+void gtp_sound_song_stop();
+void gtp_sound_song_pause();
+void gtp_sound_song_resume();
+void gtp_sound_song_set_tempo(const uint16_t percent);
+bool gtp_sound_song_is_playing();
+
 #endif /* GTP_SOUND_H__ */
@@ -0,0 +1,322 @@
+#!/usr/bin/env python3
+#
+# Converts RTTTL strings and a monophonic subset of standard MIDI files into
+# packed gtp_sound songs, along with the PWM period of every note so that the
+# firmware does not have to divide at runtime, and the note envelope tables.
+#
+# The notes the hardware can play are read from the NOTE_* defines and the
+# GTP_SOUND_NOTES() list of gtp_sound.h. Songs going below the lowest note are
+# transposed up by octaves, notes still out of range are folded one by one.
+
+import argparse
+import collections
+import os
+import re
+import struct
+import sys
+
+NOTE_SEMITONES = {'C': 0, 'CS': 1, 'D': 2, 'DS': 3, 'E': 4, 'F': 5, 'FS': 6, 'G': 7, 'GS': 8,
+                  'A': 9, 'AS': 10, 'B': 11}
+RTTTL_SEMITONES = {'c': 0, 'd': 2, 'e': 4, 'f': 5, 'g': 7, 'a': 9, 'b': 11, 'h': 11}
+
+MAX_TICKS = 255
+
+
+def warn(msg):
+    print(f'gen_songs: warning: {msg}', file=sys.stderr)
+
+
+def midi_number(name):
+    m = re.fullmatch(r'([A-G]S?)(\d)', name)
+    return 12 * (int(m.group(2)) + 1) + NOTE_SEMITONES[m.group(1)]
+
+
+def read_notes(header):
+    """Returns the playable notes in index order as (name, midi number, frequency)."""
+    text = open(header).read()
+    frequencies = dict(re.findall(r'#define\s+NOTE_(\w+)\s+(\d+)', text))
+    m = re.search(r'#define\s+GTP_SOUND_NOTES\(X\)((?:[^\n]*\\\n)*[^\n]*)', text)
+    if m is None:
+        sys.exit(f'gen_songs: GTP_SOUND_NOTES() not found in {header}')
+    names = re.findall(r'X\((\w+)\)', m.group(1))
+    return [(name, midi_number(name), int(frequencies[name])) for name in names]
+
+
+def parse_rtttl(path):
+    """Returns a list of (midi number or None for a rest, duration in ms)."""
+    text = ''.join(open(path).read().split())
+    try:
+        _, defaults, body = text.split(':')
+    except ValueError:
+        sys.exit(f'gen_songs: {path}: expecting name:defaults:notes')
+
+    settings = {'d': 4, 'o': 6, 'b': 63}
+    for item in filter(None, defaults.split(',')):
+        key, value = item.split('=')
+        settings[key.lower()] = int(value)
+    whole_ms = 4 * 60000 / settings['b']
+
+    events = []
+    for token in filter(None, body.lower().split(',')):
+        m = re.fullmatch(r'(\d*)([a-hp])(#?)(\.?)(\d?)(\.?)', token)
+        if m is None:
+            sys.exit(f'gen_songs: {path}: bad note "{token}"')
+        duration = int(m.group(1)) if m.group(1) else settings['d']
+        ms = whole_ms / duration
+        if m.group(4) or m.group(6):
+            ms *= 1.5
+
+        if m.group(2) == 'p':
+            events.append((None, ms))
+            continue
+
+        octave = int(m.group(5)) if m.group(5) else settings['o']
+        semitone = RTTTL_SEMITONES[m.group(2)] + (1 if m.group(3) else 0)
+        events.append((12 * (octave + 1) + semitone, ms))
+
+    return events
+
+
+def read_varlen(data, pos):
+    value = 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        value = (value << 7) | (byte & 0x7F)
+        if not byte & 0x80:
+            return value, pos
+
+
+def parse_midi_track(data):
+    """Returns the (tick, kind, value) events of a track, kind being 'tempo',
+    'on' or 'off' with the tempo in us per quarter or the note number."""
+    events = []
+    pos = tick = 0
+    status = 0
+    while pos < len(data):
+        delta, pos = read_varlen(data, pos)
+        tick += delta
+        if data[pos] & 0x80:
+            status = data[pos]
+            pos += 1
+
+        if status == 0xFF:
+            kind = data[pos]
+            length, pos = read_varlen(data, pos + 1)
+            if kind == 0x51:
+                events.append((tick, 'tempo', int.from_bytes(data[pos:pos + 3], 'big')))
+            elif kind == 0x2F:
+                break
+            pos += length
+        elif status in (0xF0, 0xF7):
+            length, pos = read_varlen(data, pos)
+            pos += length
+        else:
+            kind = status & 0xF0
+            if kind in (0xC0, 0xD0):
+                pos += 1
+                continue
+            note, velocity = data[pos], data[pos + 1]
+            pos += 2
+            if kind == 0x90 and velocity > 0:
+                events.append((tick, 'on', note))
+            elif kind == 0x80 or kind == 0x90:
+                events.append((tick, 'off', note))
+
+    return events
+
+
+def parse_midi(path):
+    """Plays the first track having notes, a note starting cuts the current one."""
+    data = open(path, 'rb').read()
+    if data[:4] != b'MThd':
+        sys.exit(f'gen_songs: {path}: not a midi file')
+    length, _, ntracks, division = struct.unpack('>IHHH', data[4:14])
+    if division & 0x8000:
+        sys.exit(f'gen_songs: {path}: SMPTE time division is not supported')
+
+    pos = 8 + length
+    tracks = []
+    for _ in range(ntracks):
+        kind, length = struct.unpack('>4sI', data[pos:pos + 8])
+        if kind == b'MTrk':
+            tracks.append(parse_midi_track(data[pos + 8:pos + 8 + length]))
+        pos += 8 + length
+
+    tempos = sorted((t, v) for track in tracks for t, k, v in track if k == 'tempo')
+    notes = next(([e for e in track if e[1] != 'tempo'] for track in tracks
+                  if any(k == 'on' for _, k, _ in track)), [])
+    if not notes:
+        sys.exit(f'gen_songs: {path}: no note found')
+
+    def tick_to_ms(tick):
+        ms, last_tick, tempo = 0.0, 0, 500000
+        for t, value in tempos:
+            if t >= tick:
+                break
+            ms += (t - last_tick) * tempo / division / 1000
+            last_tick, tempo = t, value
+        return ms + (tick - last_tick) * tempo / division / 1000
+
+    events = []
+    current = None
+    last_ms = 0.0
+    for tick, kind, note in notes:
+        ms = tick_to_ms(tick)
+        if kind == 'on' or (kind == 'off' and note == current):
+            events.append((current, ms - last_ms))
+            last_ms = ms
+            current = note if kind == 'on' else None
+
+    # the leading silence is not part of the song
+    if events and events[0][0] is None:
+        events = events[1:]
+    return [e for e in events if e[1] > 0]
+
+
+def fit_to_range(events, notes, path):
+    """Transposes the song by octaves, then folds notes still out of range."""
+    lowest, highest = notes[0][1], notes[-1][1]
+    pitches = [n for n, _ in events if n is not None]
+    if not pitches:
+        return events
+
+    shift = 0
+    while min(pitches) + shift < lowest and max(pitches) + shift + 12 <= highest:
+        shift += 12
+    while max(pitches) + shift > highest and min(pitches) + shift - 12 >= lowest:
+        shift -= 12
+    if shift:
+        warn(f'{path}: transposed by {shift // 12} octave(s)')
+
+    fitted = []
+    for note, ms in events:
+        if note is not None:
+            note += shift
+            if note < lowest or note > highest:
+                warn(f'{path}: note {note} folded into the playable range')
+            while note < lowest:
+                note += 12
+            while note > highest:
+                note -= 12
+        fitted.append((note, ms))
+
+    return fitted
+
+
+def pack_song(events, notes, tick_ms, gap_ms):
+    """Each event lasts its whole duration, the note sounds for the duration
+    minus the gap, rests and notes too short for a gap are played legato."""
+    names = {midi: name for name, midi, _ in notes}
+    packed = []
+    for note, ms in events:
+        name = names[note] if note is not None else 'REST'
+        legato = note is None or ms < 2 * gap_ms
+        ticks = round((ms if legato else ms - gap_ms) / tick_ms)
+        if ticks > MAX_TICKS:
+            warn(f'{name} of {ms:.0f}ms is cut to {MAX_TICKS * tick_ms}ms')
+        packed.append((name, legato, min(max(ticks, 1), MAX_TICKS)))
+
+    default_ticks = collections.Counter(t for _, _, t in packed).most_common(1)[0][0]
+
+    items = []
+    for name, legato, ticks in packed:
+        macro = 'SONG_LEGATO' if legato else 'SONG_NOTE'
+        if ticks == default_ticks:
+            items.append(f'{macro}({name})')
+        else:
+            items.append(f'{macro}_TICKS({name}, {ticks})')
+
+    return items, default_ticks
+
+
+def envelope_tables(period_ms, attack_ms, decay_ms, sustain_percent, release_ms, glide_ms):
+    """Levels are 0 to 255, the attack and decay table ends on the sustain
+    level, the release table is indexed by the steps left till the note end."""
+    sustain = round(255 * sustain_percent / 100)
+    attack = max(1, round(attack_ms / period_ms))
+    decay = round(decay_ms / period_ms)
+    release = max(1, round(release_ms / period_ms))
+    glide = max(1, round(glide_ms / period_ms))
+
+    attack_decay = [round(255 * (i + 1) / attack) for i in range(attack)]
+    attack_decay += [round(255 - (255 - sustain) * (i + 1) / decay) for i in range(decay)]
+    attack_decay.append(sustain)
+
+    return {
+        'envelope_attack_decay': attack_decay,
+        'envelope_release': [round(256 * i / release) for i in range(release)],
+        'glide_curve': [min(255, round(256 * (i + 1) / glide)) for i in range(glide)],
+    }
+
+
+def format_table(name, values):
+    out = [f'static const uint8_t {name}[] = {{']
+    line = '\t'
+    for value in values:
+        item = f'{value}, '
+        if len(line.expandtabs(8)) + len(item) > 100:
+            out.append(line.rstrip())
+            line = '\t'
+        line += item
+    return out + [line.rstrip(), '};', '']
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Builds the gtp_sound song tables')
+    parser.add_argument('--notes', required=True, help='gtp_sound.h defining the notes')
+    parser.add_argument('--output', required=True, help='generated header')
+    parser.add_argument('--tick-ms', type=int, default=50)
+    parser.add_argument('--gap-ms', type=int, default=50)
+    parser.add_argument('--envelope', type=int, nargs=6,
+                        metavar=('PERIOD_MS', 'ATTACK_MS', 'DECAY_MS', 'SUSTAIN_PERCENT',
+                                 'RELEASE_MS', 'GLIDE_MS'),
+                        help='generates the envelope tables')
+    parser.add_argument('songs', nargs='*', help='.rtttl or .mid files')
+    args = parser.parse_args()
+
+    notes = read_notes(args.notes)
+
+    out = ['/* Generated by gen_songs.py, do not edit. */', '',
+           '/* PWM period of each note, indexed by enum song_note_idx_e */',
+           'static const uint32_t note_periods_ns[] = {', '\t0, // REST']
+    for name, _, frequency in notes:
+        out.append(f'\t{round(1e9 / frequency)}, // {name}')
+    out += ['};', '']
+
+    if args.envelope:
+        out.append(f'/* envelope levels every {args.envelope[0]}ms */')
+        for name, values in envelope_tables(*args.envelope).items():
+            out += format_table(name, values)
+
+    for path in args.songs:
+        name = re.sub(r'\W', '_', os.path.splitext(os.path.basename(path))[0])
+        events = parse_midi(path) if path.endswith(('.mid', '.midi')) else parse_rtttl(path)
+        events = fit_to_range(events, notes, path)
+        items, default_ticks = pack_song(events, notes, args.tick_ms, args.gap_ms)
+
+        out.append(f'/* {os.path.basename(path)} */')
+        out.append(f'static const uint8_t {name}_notes[] = {{')
+        line = '\t'
+        for item in items + ['SONG_END']:
+            if len(line.expandtabs(8)) + len(item) + 2 > 100:
+                out.append(line.rstrip())
+                line = '\t'
+            line += f'{item}, '
+        out.append(line.rstrip())
+        out += ['};', '',
+                f'static const gtp_sound_song_t {name}_song = {{',
+                f'\t.notes = {name}_notes,',
+                f'\t.size = sizeof({name}_notes),',
+                f'\t.tick_ms = {args.tick_ms},',
+                f'\t.default_ticks = {default_ticks},',
+                f'\t.gap_ms = {args.gap_ms},',
+                '};', '']
+
+    os.makedirs(os.path.dirname(os.path.abspath(args.output)), exist_ok=True)
+    with open(args.output, 'w') as f:
+        f.write('\n'.join(out))
+
+
+if __name__ == '__main__':
+    main()
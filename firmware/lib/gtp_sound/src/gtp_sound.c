@@ -2,230 +2,773 @@
 #include <gtp_game.h>
 #include <zephyr/kernel.h>
 #include <zephyr/drivers/pwm.h>
+#include <string.h>
+
+#include "gtp_sound_songs.h"
 
 #include <zephyr/logging/log.h>
 LOG_MODULE_REGISTER(gtp_sound, CONFIG_GTPSOUND_LOG_LEVEL);
 
-#define STACK_SIZE            256
-#define PRIORITY              5
-#define SOUND_PERIOD_MS       10
-#define DEFAULT_MUTEX_TIMEOUT K_MSEC(10)
+/* Notes are posted as a single word per channel so that they can be sent from
+ * any context without lock: up to 3 note indexes, the duration in 4ms units and
+ * a pending bit. A zero duration is a note off, for every note when no note is
+ * given. Sound effects only have one voice, the other voice bits hold their
+ * priority. The one shot note timer applies the commands, then is armed for
+ * the end of the first note to stop. Nothing runs while no note is playing.
+ *
+ * The sound effect channel takes the buzzer over the music, which keeps its
+ * timeline and is heard again at its current position once the effect is over.
+ *
+ * A buzzer plays a single frequency, chords are arpeggiated: while more than
+ * one voice plays, the periodic voice timer switches the output to the next
+ * voice. Both timers expire from the system clock interrupt. */
+#define CMD_VOICE_BITS       6
+#define CMD_VOICE_MASK       0x3Fu
+#define CMD_VOICES_MASK      0x3FFFFu
+#define CMD_PRIORITY_SHIFT   CMD_VOICE_BITS
+#define CMD_PRIORITY_MASK    0xFFFu
+#define CMD_DURATION_SHIFT   18
+#define CMD_DURATION_MASK    0x1FFFu
+#define CMD_DURATION_UNIT_MS 4
+#define CMD_DURATION_FOREVER CMD_DURATION_MASK
+#define CMD_PENDING          BIT(31)
+
+BUILD_ASSERT(SONG_IDX_COUNT <= CMD_VOICE_MASK);
+BUILD_ASSERT(GTP_SOUND_MAX_VOICES * CMD_VOICE_BITS <= CMD_DURATION_SHIFT);
+
+/* by increasing priority */
+enum sound_channel_e {
+	SOUND_CHANNEL_MUSIC = 0,
+	SOUND_CHANNEL_SFX,
+	SOUND_CHANNEL_COUNT,
+};
 
-static void sound_entry_point(void *, void *, void *);
+typedef struct {
+	atomic_t command;
+	/* only used from the note and voice timer expiries */
+	bool playing;
+	bool forever;
+	int64_t end_ticks;
+	uint16_t priority;
+	uint8_t voices[GTP_SOUND_MAX_VOICES];
+	uint8_t voice_count;
+} sound_channel_t;
+
+static void note_timer_expired(struct k_timer *timer);
+static void voice_timer_expired(struct k_timer *timer);
+
+K_TIMER_DEFINE(note_timer, note_timer_expired, NULL);
+K_TIMER_DEFINE(voice_timer, voice_timer_expired, NULL);
+
+static sound_channel_t channels[SOUND_CHANNEL_COUNT];
+
+/* only used from the note and voice timer expiries */
+static sound_channel_t *output_channel;
+static uint8_t current_voice;
+
+/* the pulse is a 1/256 of the period */
+static const uint8_t pwm_pulse_shift = 8u;
+static const struct pwm_dt_spec pwm_led0 = PWM_DT_SPEC_GET(DT_ALIAS(pwmled0));
 
-K_THREAD_DEFINE(sound_tid, STACK_SIZE, sound_entry_point, NULL, NULL, NULL, PRIORITY, K_ESSENTIAL,
-		0);
+#if defined(CONFIG_GTP_SOUND_OUTPUT_PRELOAD)
+/* TIM1 counts at 48MHz, 740Hz is the lowest note with a 16 bits period */
+static uint16_t note_period_cycles[SONG_IDX_COUNT];
+static uint16_t current_period_cycles;
+#endif
 
-K_MUTEX_DEFINE(sound_mutex);
+#define NOTE_FREQUENCY_ENTRY(note) NOTE_##note,
 
-K_SEM_DEFINE(tell_it_on_the_mountain_start, 0, 1);
-K_SEM_DEFINE(merry_christmas_start, 0, 1);
+static const uint16_t note_frequencies[] = {REST, GTP_SOUND_NOTES(NOTE_FREQUENCY_ENTRY)};
 
-typedef enum {
-	SOUND_IDLE = 0,
-	SOUND_TO_START,
-	SOUND_ONGOING,
-	SOUND_TO_STOP
-} sound_state_e;
+BUILD_ASSERT(ARRAY_SIZE(note_frequencies) == SONG_IDX_COUNT);
+BUILD_ASSERT(ARRAY_SIZE(note_periods_ns) == SONG_IDX_COUNT, "gtp_sound_songs.h is out of date");
+BUILD_ASSERT(SONG_IDX_COUNT <= SONG_CONTROL, "note indexes overlap the control codes");
 
-typedef struct {
-	int remaining_duration_ms;
-	uint16_t frequency;
-	sound_state_e state;
-} sound_state_t;
-
-static sound_state_t sound_state;
-static const uint16_t pwm_pulse_factor = 256u;
-static const struct pwm_dt_spec pwm_led0 = PWM_DT_SPEC_GET(DT_ALIAS(pwmled0));
 static const char tell_it_on_the_mountain_title[] = "surprise song";
 static const char merry_christmas_title[] = "merry christmas song";
 
-static void sound_entry_point(void *, void *, void *)
+#if defined(CONFIG_GTP_SOUND_OUTPUT_PRELOAD)
+static void init_note_output()
 {
-	while (1) {
+	uint64_t cycles_per_sec;
 
-		const int ret = k_mutex_lock(&sound_mutex, DEFAULT_MUTEX_TIMEOUT);
-		if (ret != 0) {
-			LOG_ERR("mutex lock failed\n");
-		} else {
+	if (pwm_get_cycles_per_sec(pwm_led0.dev, pwm_led0.channel, &cycles_per_sec) != 0) {
+		LOG_ERR("cannot get the %s clock", pwm_led0.dev->name);
+		return;
+	}
+
+	for (int i = SONG_IDX_REST + 1; i < SONG_IDX_COUNT; i++) {
+		const uint64_t cycles = cycles_per_sec * note_periods_ns[i] / NSEC_PER_SEC;
+
+		if (cycles > UINT16_MAX) {
+			LOG_ERR("note %d is too low for the timer", i);
+		}
+		note_period_cycles[i] = MIN(cycles, UINT16_MAX);
+	}
+
+	current_period_cycles = note_period_cycles[SONG_IDX_REST + 1];
+}
+
+#if defined(CONFIG_GTP_SOUND_ENVELOPE)
+/* The envelope timer changes the pulse of the note at a few hundred Hz from
+ * the generated envelope_* tables, and slides the period along glide_curve. */
+static void envelope_timer_expired(struct k_timer *timer);
+
+K_TIMER_DEFINE(envelope_timer, envelope_timer_expired, NULL);
+
+/* only used from the timer expiries */
+static struct {
+	uint16_t step;      // since the attack
+	int32_t remaining;  // steps till the note end, -1 for a held note
+	uint8_t level;
+	uint8_t glide_step; // ARRAY_SIZE(glide_curve) when not gliding
+	uint16_t glide_from;
+	uint16_t glide_to;
+	bool sounding;
+} envelope = {.glide_step = ARRAY_SIZE(glide_curve)};
+
+static void write_note_output()
+{
+	/* the new period and pulse are taken at the next update event */
+	pwm_set_cycles(pwm_led0.dev, pwm_led0.channel, current_period_cycles,
+		       ((current_period_cycles >> pwm_pulse_shift) * envelope.level) >> 8,
+		       pwm_led0.flags);
+}
+
+static void envelope_timer_expired(struct k_timer *timer)
+{
+	const bool sustained = envelope.step >= ARRAY_SIZE(envelope_attack_decay) - 1;
+	uint8_t level = envelope_attack_decay[sustained ? ARRAY_SIZE(envelope_attack_decay) - 1
+						      : envelope.step++];
+
+	if (envelope.remaining >= 0) {
+		if (envelope.remaining < ARRAY_SIZE(envelope_release)) {
+			level = (level * envelope_release[envelope.remaining]) >> 8;
+		}
+		if (envelope.remaining > 0) {
+			envelope.remaining--;
+		}
+	}
+
+	if (envelope.glide_step < ARRAY_SIZE(glide_curve) - 1) {
+		current_period_cycles =
+			envelope.glide_from + (((int32_t)envelope.glide_to - envelope.glide_from) *
+					       glide_curve[envelope.glide_step++] >> 8);
+	} else if (envelope.glide_step == ARRAY_SIZE(glide_curve) - 1) {
+		current_period_cycles = envelope.glide_to;
+		envelope.glide_step++;
+	}
 
-			switch (sound_state.state) {
-			case SOUND_TO_START:
-				pwm_set_dt(&pwm_led0, PWM_HZ(sound_state.frequency),
-					   PWM_HZ(sound_state.frequency) / pwm_pulse_factor);
-				sound_state.remaining_duration_ms -= SOUND_PERIOD_MS;
-				sound_state.state = SOUND_ONGOING;
-				break;
-			case SOUND_ONGOING:
-				sound_state.remaining_duration_ms -= SOUND_PERIOD_MS;
-				if (sound_state.remaining_duration_ms <= 0) {
-					sound_state.state = SOUND_TO_STOP;
-				}
-				break;
-			case SOUND_TO_STOP:
-				pwm_set_dt(&pwm_led0, PWM_HZ(1024u), 0);
-				sound_state.state = SOUND_IDLE;
-				break;
-			case SOUND_IDLE:
-			default:
-				break;
+	envelope.level = level;
+	write_note_output();
+
+	/* nothing changes on a held note once sustained */
+	if (sustained && envelope.remaining < 0 && envelope.glide_step >= ARRAY_SIZE(glide_curve)) {
+		k_timer_stop(timer);
+	}
+}
+
+static void set_note_output(const uint8_t note_idx)
+{
+	if (note_idx != SONG_IDX_REST) {
+		current_period_cycles = note_period_cycles[note_idx];
+		envelope.glide_step = ARRAY_SIZE(glide_curve);
+		write_note_output();
+		return;
+	}
+
+	k_timer_stop(&envelope_timer);
+	envelope.sounding = false;
+	envelope.level = 0;
+	write_note_output();
+}
+
+/* Starts the envelope of the first voice of the channel, a note tied to the
+ * one still sounding glides to its pitch without a new attack. */
+static void start_note_output(const sound_channel_t *channel)
+{
+	const uint16_t period_cycles = note_period_cycles[channel->voices[0]];
+
+	if (channel->forever) {
+		envelope.remaining = -1;
+	} else {
+		const int64_t left = MAX(channel->end_ticks - k_uptime_ticks(), 0);
+
+		envelope.remaining =
+			k_ticks_to_ms_floor32((uint32_t)left) / CONFIG_GTP_SOUND_ENVELOPE_PERIOD_MS;
+	}
+
+	if (envelope.sounding && CONFIG_GTP_SOUND_GLIDE_MS > 0) {
+		envelope.glide_from = current_period_cycles;
+		envelope.glide_to = period_cycles;
+		envelope.glide_step = 0;
+	} else {
+		current_period_cycles = period_cycles;
+		envelope.glide_step = ARRAY_SIZE(glide_curve);
+		envelope.step = 0;
+		envelope.level = 0;
+	}
+
+	envelope.sounding = true;
+	envelope_timer_expired(&envelope_timer);
+	k_timer_start(&envelope_timer, K_MSEC(CONFIG_GTP_SOUND_ENVELOPE_PERIOD_MS),
+		      K_MSEC(CONFIG_GTP_SOUND_ENVELOPE_PERIOD_MS));
+}
+#else
+static void set_note_output(const uint8_t note_idx)
+{
+	/* the new period and pulse are taken at the next update event */
+	if (note_idx != SONG_IDX_REST) {
+		current_period_cycles = note_period_cycles[note_idx];
+		pwm_set_cycles(pwm_led0.dev, pwm_led0.channel, current_period_cycles,
+			       current_period_cycles >> pwm_pulse_shift, pwm_led0.flags);
+	} else {
+		pwm_set_cycles(pwm_led0.dev, pwm_led0.channel, current_period_cycles, 0,
+			       pwm_led0.flags);
+	}
+}
+#endif /* CONFIG_GTP_SOUND_ENVELOPE */
+#else
+static void init_note_output()
+{
+}
+
+static void set_note_output(const uint8_t note_idx)
+{
+	if (note_idx != SONG_IDX_REST) {
+		const uint32_t period_ns = note_periods_ns[note_idx];
+
+		pwm_set_dt(&pwm_led0, period_ns, period_ns >> pwm_pulse_shift);
+	} else {
+		pwm_set_dt(&pwm_led0, PWM_HZ(1024u), 0);
+	}
+}
+#endif
+
+#if !defined(CONFIG_GTP_SOUND_ENVELOPE)
+static void start_note_output(const sound_channel_t *channel)
+{
+	set_note_output(channel->voices[0]);
+}
+#endif
+
+/* changed has a bit per channel whose note changed, a note changing under a
+ * sound effect is not heard */
+static void update_output(const uint8_t changed)
+{
+	sound_channel_t *top = NULL;
+	int top_idx;
+
+	for (top_idx = SOUND_CHANNEL_COUNT - 1; top_idx >= 0; top_idx--) {
+		if (channels[top_idx].playing) {
+			top = &channels[top_idx];
+			break;
+		}
+	}
+
+	if (top != NULL && top == output_channel && !(changed & BIT(top_idx))) {
+		return;
+	}
+
+	output_channel = top;
+	current_voice = 0;
+
+	if (top == NULL) {
+		k_timer_stop(&voice_timer);
+		set_note_output(SONG_IDX_REST);
+		return;
+	}
+
+	start_note_output(top);
+
+	if (top->voice_count > 1) {
+		k_timer_start(&voice_timer, K_MSEC(CONFIG_GTP_SOUND_ARPEGGIO_PERIOD_MS),
+			      K_MSEC(CONFIG_GTP_SOUND_ARPEGGIO_PERIOD_MS));
+	} else {
+		k_timer_stop(&voice_timer);
+	}
+}
+
+static void voice_timer_expired(struct k_timer *timer)
+{
+	if (output_channel == NULL || output_channel->voice_count < 2) {
+		k_timer_stop(timer);
+		return;
+	}
+
+	current_voice = (current_voice + 1) % output_channel->voice_count;
+	set_note_output(output_channel->voices[current_voice]);
+}
+
+/* returns true when the channel state changed */
+static bool apply_command(sound_channel_t *channel, const atomic_val_t cmd, const bool is_sfx)
+{
+	const uint16_t duration = (cmd >> CMD_DURATION_SHIFT) & CMD_DURATION_MASK;
+	const uint16_t priority = is_sfx ? (cmd >> CMD_PRIORITY_SHIFT) & CMD_PRIORITY_MASK : 0;
+	const int voice_bits = is_sfx ? 1 : GTP_SOUND_MAX_VOICES;
+	uint8_t voices[GTP_SOUND_MAX_VOICES];
+	uint8_t count = 0;
+
+	for (int i = 0; i < voice_bits; i++) {
+		const uint8_t note_idx = (cmd >> (i * CMD_VOICE_BITS)) & CMD_VOICE_MASK;
+
+		if (note_idx != SONG_IDX_REST && note_idx < SONG_IDX_COUNT) {
+			voices[count++] = note_idx;
+		}
+	}
+
+	if (duration == 0) {
+		/* a note off only stops its own note, a rest stops any */
+		if (!channel->playing ||
+		    (count > 0 && (channel->voice_count != 1 || channel->voices[0] != voices[0]))) {
+			return false;
+		}
+		channel->playing = false;
+		return true;
+	}
+
+	if (count == 0) {
+		return false;
+	}
+
+	if (channel->playing && priority < channel->priority) {
+		// a more important effect is still playing
+		return false;
+	}
+
+	memcpy(channel->voices, voices, count);
+	channel->voice_count = count;
+	channel->priority = priority;
+	channel->playing = true;
+	channel->forever = duration == CMD_DURATION_FOREVER;
+	channel->end_ticks =
+		k_uptime_ticks() + k_ms_to_ticks_ceil64(duration * CMD_DURATION_UNIT_MS);
+	return true;
+}
+
+static void note_timer_expired(struct k_timer *timer)
+{
+	const int64_t now = k_uptime_ticks();
+	int64_t next_end_ticks = INT64_MAX;
+	uint8_t changed = 0;
+
+	for (int i = 0; i < SOUND_CHANNEL_COUNT; i++) {
+		sound_channel_t *channel = &channels[i];
+		const atomic_val_t cmd = atomic_clear(&channel->command);
+
+		if (cmd & CMD_PENDING) {
+			if (apply_command(channel, cmd, i == SOUND_CHANNEL_SFX)) {
+				changed |= BIT(i);
 			}
 		}
 
-		k_mutex_unlock(&sound_mutex);
+		if (!channel->playing || channel->forever) {
+			continue;
+		}
+
+		if (now >= channel->end_ticks) {
+			channel->playing = false;
+			changed |= BIT(i);
+		} else {
+			next_end_ticks = MIN(next_end_ticks, channel->end_ticks);
+		}
+	}
+
+	if (changed) {
+		update_output(changed);
+	}
 
-		k_msleep(SOUND_PERIOD_MS);
+	/* the timer may also have been restarted by a new command, it is armed
+	 * again for the first note to end */
+	if (next_end_ticks != INT64_MAX) {
+		k_timer_start(timer, K_TIMEOUT_ABS_TICKS(next_end_ticks), K_NO_WAIT);
 	}
 }
 
+static uint32_t to_command_duration(const int duration_ms)
+{
+	return (duration_ms < 0 || duration_ms >= CMD_DURATION_FOREVER * CMD_DURATION_UNIT_MS)
+		       ? CMD_DURATION_FOREVER
+		       : DIV_ROUND_UP(duration_ms, CMD_DURATION_UNIT_MS);
+}
+
+/* voices holds one note index per CMD_VOICE_BITS, a single note is its index */
+static void post_note_command(const uint32_t packed_voices, const int duration_ms)
+{
+	atomic_set(&channels[SOUND_CHANNEL_MUSIC].command,
+		   CMD_PENDING | (to_command_duration(duration_ms) << CMD_DURATION_SHIFT) |
+			   (packed_voices & CMD_VOICES_MASK));
+	k_timer_start(&note_timer, K_NO_WAIT, K_NO_WAIT);
+}
+
+/* A pending note of the channel replaces the note being stopped anyway, the note
+ * off only replaces a pending command for its own note. */
+static void post_note_off_command(const uint8_t note_idx)
+{
+	atomic_t *command = &channels[SOUND_CHANNEL_MUSIC].command;
+	atomic_val_t old;
+
+	do {
+		old = atomic_get(command);
+		if ((old & CMD_PENDING) && (old & CMD_VOICES_MASK) != note_idx) {
+			return;
+		}
+	} while (!atomic_cas(command, old, CMD_PENDING | note_idx));
+
+	k_timer_start(&note_timer, K_NO_WAIT, K_NO_WAIT);
+}
+
+static void post_sfx_command(const uint8_t note_idx, const int duration_ms,
+			     const uint16_t priority)
+{
+	atomic_set(&channels[SOUND_CHANNEL_SFX].command,
+		   CMD_PENDING | (to_command_duration(duration_ms) << CMD_DURATION_SHIFT) |
+			   ((priority & CMD_PRIORITY_MASK) << CMD_PRIORITY_SHIFT) |
+			   (note_idx & CMD_VOICE_MASK));
+	k_timer_start(&note_timer, K_NO_WAIT, K_NO_WAIT);
+}
+
 void gtp_sound_init(void)
 {
 	if (!pwm_is_ready_dt(&pwm_led0)) {
 		LOG_ERR("PWM device %s is not ready\n", pwm_led0.dev->name);
 	}
 
-	k_sem_take(&tell_it_on_the_mountain_start, K_NO_WAIT);
-	k_sem_take(&merry_christmas_start, K_NO_WAIT);
+	init_note_output();
 }
 
 void gtp_sound_good_short_bip()
 {
-	gtp_game_sound_play_note(BIP_GOOD, 40);
+	gtp_sound_play_sfx(BIP_GOOD, 40, GTP_SOUND_SFX_PRIORITY_LOW);
 }
 
 void gtp_sound_good_long_bip()
 {
-	gtp_game_sound_play_note(BIP_GOOD, 300);
+	gtp_sound_play_sfx(BIP_GOOD, 300, GTP_SOUND_SFX_PRIORITY_NORMAL);
 }
 
 void gtp_sound_error_long_bip()
 {
-	gtp_game_sound_play_note(BIP_BAD, 300);
+	gtp_sound_play_sfx(BIP_BAD, 300, GTP_SOUND_SFX_PRIORITY_HIGH);
 }
 
-void gtp_game_sound_play_note(const uint16_t note, const int duration_ms)
+/* The periods are computed at build time, a frequency is played as the closest
+ * note of the table. */
+static uint8_t note_index_of(const uint16_t frequency)
 {
-	const int ret = k_mutex_lock(&sound_mutex, DEFAULT_MUTEX_TIMEOUT);
-	if (ret != 0) {
-		LOG_ERR("mutex lock failed\n");
-		return;
+	uint8_t lo = SONG_IDX_REST + 1;
+	uint8_t hi = SONG_IDX_COUNT - 1;
+
+	if (frequency == REST) {
+		return SONG_IDX_REST;
 	}
 
-	sound_state.frequency = note;
-	sound_state.remaining_duration_ms = duration_ms;
-	sound_state.state = SOUND_TO_START;
+	while (lo < hi) {
+		const uint8_t mid = (lo + hi) / 2;
+
+		if (note_frequencies[mid] < frequency) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
 
-	k_mutex_unlock(&sound_mutex);
+	if (lo > SONG_IDX_REST + 1 &&
+	    frequency - note_frequencies[lo - 1] < note_frequencies[lo] - frequency) {
+		lo--;
+	}
+
+	return lo;
 }
 
-void gtp_game_sound_rest()
+void gtp_game_sound_play_note(const uint16_t note, const int duration_ms)
 {
-	const int ret = k_mutex_lock(&sound_mutex, DEFAULT_MUTEX_TIMEOUT);
-	if (ret != 0) {
-		LOG_ERR("mutex lock failed\n");
-		return;
+	post_note_command(note_index_of(note), duration_ms);
+}
+
+void gtp_sound_play_chord(const uint16_t *notes, const int count, const int duration_ms)
+{
+	uint32_t packed = 0;
+
+	for (int i = 0; i < MIN(count, GTP_SOUND_MAX_VOICES); i++) {
+		packed |= (uint32_t)note_index_of(notes[i]) << (i * CMD_VOICE_BITS);
 	}
 
-	sound_state.frequency = 0;
-	sound_state.remaining_duration_ms = 0;
-	sound_state.state = SOUND_TO_STOP;
+	post_note_command(packed, duration_ms);
+}
 
-	k_mutex_unlock(&sound_mutex);
+void gtp_sound_note_off(const uint16_t note)
+{
+	post_note_off_command(note_index_of(note));
 }
 
-static void play_song(const uint16_t melody[], const int durations_ms[], const int len)
+void gtp_sound_play_sfx(const uint16_t note, const int duration_ms, const uint16_t priority)
 {
-	for (uint8_t i = 0; i < len; ++i) {
-		gtp_game_sound_play_note(melody[i], durations_ms[i]);
-		k_msleep(durations_ms[i] + 150);
-	}
+	post_sfx_command(note_index_of(note), duration_ms, priority);
 }
 
-const char *gtp_sound_tell_it_on_the_mountain_get_menu_title()
+void gtp_game_sound_rest()
 {
-	return tell_it_on_the_mountain_title;
+	post_note_command(SONG_IDX_REST, 0);
 }
 
-void gtp_sound_tell_it_on_the_mountain_start()
+/* The sequencer plays the notes from its own one shot timer. Each note starts
+ * at an absolute deadline computed from the previous one, so timer latencies
+ * do not add up along the song. */
+static void sequencer_timer_expired(struct k_timer *timer);
+
+K_TIMER_DEFINE(sequencer_timer, sequencer_timer_expired, NULL);
+
+static struct {
+	const gtp_sound_song_t *song;
+	gtp_sound_song_done_cb_t done_cb;
+	uint16_t pos;         // next byte to decode
+	uint16_t section_pos; // first byte after the last section start
+	int16_t repeats_left; // -1 till the repeat code is reached
+	int64_t deadline_ticks;   // start of the next note
+	int64_t paused_remaining; // ticks till the next note when paused
+	uint16_t tempo_percent;
+	bool paused;
+} sequencer = {.tempo_percent = 100};
+
+static struct k_spinlock sequencer_lock;
+
+static inline int scale_to_tempo_ms(const int duration_ms)
 {
-	k_sem_give(&tell_it_on_the_mountain_start);
+	/* this function must be called under sequencer_lock protection only */
+	return duration_ms * 100 / sequencer.tempo_percent;
 }
 
-const char *gtp_sound_merry_christmas_get_menu_title()
+/* Decodes the song straight from flash up to the next note, following the
+ * control codes, voices holds the note and the ones added by SONG_WITH() packed
+ * as a note command. Returns false at the end of the song. */
+static bool decode_next_note(uint32_t *voices_out, int *duration_ms, bool *legato)
 {
-	return merry_christmas_title;
+	/* this function must be called under sequencer_lock protection only */
+	const gtp_sound_song_t *song = sequencer.song;
+	uint32_t packed_voices = 0;
+	int count = 0;
+
+	while (sequencer.pos < song->size) {
+		const uint8_t code = song->notes[sequencer.pos++];
+		uint8_t arg = 0;
+
+		if (code & SONG_TICKS_FOLLOW) {
+			if (sequencer.pos >= song->size) {
+				LOG_ERR("song truncated at byte %u", sequencer.pos);
+				return false;
+			}
+			arg = song->notes[sequencer.pos++];
+		}
+
+		if ((code & SONG_IDX_MASK) != SONG_CONTROL) {
+			const uint8_t idx = code & SONG_IDX_MASK;
+
+			if (idx >= SONG_IDX_COUNT) {
+				LOG_ERR("unknown note index %u", idx);
+				return false;
+			}
+			if (count < GTP_SOUND_MAX_VOICES) {
+				packed_voices |= (uint32_t)idx << (count * CMD_VOICE_BITS);
+			}
+			*voices_out = packed_voices;
+			*duration_ms = ((code & SONG_TICKS_FOLLOW) ? arg : song->default_ticks) *
+				       song->tick_ms;
+			*legato = (code & SONG_LEGATO_FLAG) != 0;
+			return true;
+		}
+
+		switch (code) {
+		case SONG_SECTION:
+			sequencer.section_pos = sequencer.pos;
+			sequencer.repeats_left = -1;
+			break;
+
+		case SONG_TICKS_FOLLOW | SONG_CONTROL:
+			if (sequencer.repeats_left < 0) {
+				sequencer.repeats_left = arg;
+			}
+			if (sequencer.repeats_left > 0) {
+				sequencer.repeats_left--;
+				sequencer.pos = sequencer.section_pos;
+			} else {
+				sequencer.repeats_left = -1;
+			}
+			break;
+
+		case SONG_WITH_CODE:
+			if (count < GTP_SOUND_MAX_VOICES - 1 && arg < SONG_IDX_COUNT) {
+				packed_voices |= (uint32_t)arg << (count * CMD_VOICE_BITS);
+				count++;
+			}
+			break;
+
+		default:
+			// SONG_END
+			return false;
+		}
+	}
+
+	return false;
 }
 
-void gtp_sound_a_merry_christmas_start()
+static void sequencer_timer_expired(struct k_timer *timer)
 {
-	k_sem_give(&merry_christmas_start);
+	uint32_t packed_voices;
+	int duration_ms;
+	bool legato;
+	gtp_sound_song_done_cb_t done_cb = NULL;
+	k_spinlock_key_t key = k_spin_lock(&sequencer_lock);
+
+	if (sequencer.song == NULL || sequencer.paused) {
+		k_spin_unlock(&sequencer_lock, key);
+		return;
+	}
+
+	if (!decode_next_note(&packed_voices, &duration_ms, &legato)) {
+		// the gap after the last note is over
+		done_cb = sequencer.done_cb;
+		sequencer.song = NULL;
+
+	} else {
+		const int gap_ms = legato ? 0 : sequencer.song->gap_ms;
+
+		post_note_command(packed_voices, scale_to_tempo_ms(duration_ms));
+		sequencer.deadline_ticks +=
+			k_ms_to_ticks_ceil64(scale_to_tempo_ms(duration_ms + gap_ms));
+		k_timer_start(timer, K_TIMEOUT_ABS_TICKS(sequencer.deadline_ticks), K_NO_WAIT);
+	}
+
+	k_spin_unlock(&sequencer_lock, key);
+
+	if (done_cb != NULL) {
+		done_cb(true);
+	}
+}
+
+void gtp_sound_song_start(const gtp_sound_song_t *song, gtp_sound_song_done_cb_t done_cb)
+{
+	gtp_sound_song_stop();
+
+	k_spinlock_key_t key = k_spin_lock(&sequencer_lock);
+
+	sequencer.song = song;
+	sequencer.done_cb = done_cb;
+	sequencer.pos = 0;
+	sequencer.section_pos = 0;
+	sequencer.repeats_left = -1;
+	sequencer.paused = false;
+	sequencer.deadline_ticks = k_uptime_ticks();
+	k_timer_start(&sequencer_timer, K_NO_WAIT, K_NO_WAIT);
+
+	k_spin_unlock(&sequencer_lock, key);
 }
 
-int gtp_sound_play_tell_it_on_the_mountain()
+void gtp_sound_song_stop()
 {
-	if (k_sem_take(&tell_it_on_the_mountain_start, K_NO_WAIT) != 0) {
-		return 0;
+	gtp_sound_song_done_cb_t done_cb = NULL;
+	k_spinlock_key_t key = k_spin_lock(&sequencer_lock);
+
+	if (sequencer.song != NULL) {
+		k_timer_stop(&sequencer_timer);
+		done_cb = sequencer.done_cb;
+		sequencer.song = NULL;
+		gtp_game_sound_rest();
 	}
 
-	static const uint16_t melody[] = {
-		NOTE_FS6, NOTE_FS6, NOTE_E6, NOTE_D6, NOTE_B5,           // Meas 03
-		NOTE_A5,  NOTE_D6,                                       // Meas 04
-		NOTE_E6,  NOTE_E6,  NOTE_E6, NOTE_D6, NOTE_E6,  NOTE_D6, // Meas 05
-		NOTE_FS6, NOTE_A6,  NOTE_B6, NOTE_A6, NOTE_FS6, NOTE_E6, // Meas 06
-		NOTE_FS6, NOTE_FS6, NOTE_E6, NOTE_D6, NOTE_B5,           // Meas 07
-		NOTE_A5,  NOTE_D6,  NOTE_G6,                             // Meas 08
-		NOTE_FS6, NOTE_D6,  NOTE_E6, NOTE_E6, NOTE_D6            // Meas 09
-	};
-	static const int noteDurations[] = {
-		700, 200, 200, 200, 200,      // Meas 03
-		700, 700,                     // Meas 04
-		150, 200, 200, 200, 500, 500, // Meas 05
-		500, 500, 200, 200, 200, 200, // Meas 06
-		700, 200, 200, 200, 200,      // Meas 07
-		700, 500, 300,                // Meas 08
-		300, 150, 300, 300, 500       // Meas 09
-	};
+	k_spin_unlock(&sequencer_lock, key);
 
-	play_song(melody, noteDurations, sizeof(melody) / sizeof(melody[0]));
+	if (done_cb != NULL) {
+		done_cb(false);
+	}
+}
 
-	return SONG_WELL_FINISHED;
+void gtp_sound_song_pause()
+{
+	k_spinlock_key_t key = k_spin_lock(&sequencer_lock);
+
+	if (sequencer.song != NULL && !sequencer.paused) {
+		k_timer_stop(&sequencer_timer);
+		sequencer.paused = true;
+		sequencer.paused_remaining = MAX(sequencer.deadline_ticks - k_uptime_ticks(), 0);
+		gtp_game_sound_rest();
+	}
+
+	k_spin_unlock(&sequencer_lock, key);
 }
 
-int gtp_sound_play_merry_christmas()
+void gtp_sound_song_resume()
 {
-	if (k_sem_take(&merry_christmas_start, K_NO_WAIT) != 0) {
-		return 0;
+	k_spinlock_key_t key = k_spin_lock(&sequencer_lock);
+
+	if (sequencer.song != NULL && sequencer.paused) {
+		sequencer.paused = false;
+		sequencer.deadline_ticks = k_uptime_ticks() + sequencer.paused_remaining;
+		k_timer_start(&sequencer_timer, K_TIMEOUT_ABS_TICKS(sequencer.deadline_ticks),
+			      K_NO_WAIT);
 	}
 
-	/* source: https://gmajormusictheory.org/Freebies/Sing/WeWishYouAMerry/WeWishYouAMerry.pdf
-	 */
+	k_spin_unlock(&sequencer_lock, key);
+}
 
-	static const uint16_t melody[] = {
-		NOTE_D6,                                        // Meas 01
-		NOTE_G6,  NOTE_G6, NOTE_A6,  NOTE_G6, NOTE_FS6, // Meas 02
-		NOTE_E6,  NOTE_E6, NOTE_E6,                     // Meas 03
-		NOTE_A6,  NOTE_A6, NOTE_B6,  NOTE_A6, NOTE_G6,  // Meas 04
-		NOTE_FS6, NOTE_D6, NOTE_D6,                     // Meas 05
-		NOTE_B6,  NOTE_B6, NOTE_C6,  NOTE_B6, NOTE_A6,  // Meas 06
-		NOTE_G6,  NOTE_E6, NOTE_D6,  NOTE_D6,           // Meas 07
-		NOTE_E6,  NOTE_A6, NOTE_FS6,                    // Meas 08
-		NOTE_G6,                                        // Meas 09
+void gtp_sound_song_set_tempo(const uint16_t percent)
+{
+	k_spinlock_key_t key = k_spin_lock(&sequencer_lock);
+	sequencer.tempo_percent = CLAMP(percent, 25, 400);
+	k_spin_unlock(&sequencer_lock, key);
+}
+
+bool gtp_sound_song_is_playing()
+{
+	return sequencer.song != NULL;
+}
+
+static int gtp_sound_play_tell_it_on_the_mountain()
+{
+	/* 50ms ticks, 200ms by default, the song ends on a D major chord */
+	static const uint8_t notes[] = {
+		SONG_NOTE_TICKS(FS6, 14), SONG_NOTE(FS6), SONG_NOTE(E6), SONG_NOTE(D6),
+		SONG_NOTE(B5),                                                    // Meas 03
+		SONG_NOTE_TICKS(A5, 14), SONG_NOTE_TICKS(D6, 14),                 // Meas 04
+		SONG_NOTE_TICKS(E6, 3), SONG_NOTE(E6), SONG_NOTE(E6), SONG_NOTE(D6),
+		SONG_NOTE_TICKS(E6, 10), SONG_NOTE_TICKS(D6, 10),                 // Meas 05
+		SONG_NOTE_TICKS(FS6, 10), SONG_NOTE_TICKS(A6, 10), SONG_NOTE(B6), SONG_NOTE(A6),
+		SONG_NOTE(FS6), SONG_NOTE(E6),                                    // Meas 06
+		SONG_NOTE_TICKS(FS6, 14), SONG_NOTE(FS6), SONG_NOTE(E6), SONG_NOTE(D6),
+		SONG_NOTE(B5),                                                    // Meas 07
+		SONG_NOTE_TICKS(A5, 14), SONG_NOTE_TICKS(D6, 10), SONG_NOTE_TICKS(G6, 6), // Meas 08
+		SONG_NOTE_TICKS(FS6, 6), SONG_NOTE_TICKS(D6, 3), SONG_NOTE_TICKS(E6, 6),
+		SONG_NOTE_TICKS(E6, 6), SONG_WITH(FS6), SONG_WITH(A6),
+		SONG_NOTE_TICKS(D6, 10),                                          // Meas 09
+		SONG_END,
 	};
 
-	// Tone durations in ms
-	static const int noteDurations[] = {
-		500,                     // Meas 01
-		350, 250, 250, 250, 350, // Meas 02
-		350, 300, 350,           // Meas 03
-		350, 250, 250, 250, 250, // Meas 04
-		350, 350, 300,           // Meas 05
-		350, 250, 250, 250, 350, // Meas 06
-		350, 350, 400, 400,      // Meas 07
-		400, 450, 450,           // Meas 08
-		900,                     // Meas 09
+	static const gtp_sound_song_t song = {
+		.notes = notes,
+		.size = sizeof(notes),
+		.tick_ms = 50,
+		.default_ticks = 4,
+		.gap_ms = 150,
 	};
 
-	play_song(melody, noteDurations, sizeof(melody) / sizeof(melody[0]));
+	/* the song plays in the background, back to the menu right away */
+	gtp_sound_song_start(&song, NULL);
+
+	return SONG_WELL_FINISHED;
+}
+
+static int gtp_sound_play_merry_christmas()
+{
+	/* songs/merry_christmas.rtttl, source:
+	 * https://gmajormusictheory.org/Freebies/Sing/WeWishYouAMerry/WeWishYouAMerry.pdf
+	 * the song plays in the background, back to the menu right away
+	 */
+	gtp_sound_song_start(&merry_christmas_song, NULL);
 
 	return SONG_WELL_FINISHED;
 }
+
+GTP_GAME_DEFINE(50, tell_it_on_the_mountain, tell_it_on_the_mountain_title,
+		NULL, gtp_sound_play_tell_it_on_the_mountain, gtp_sound_song_stop, 0);
+GTP_GAME_DEFINE(51, merry_christmas, merry_christmas_title, NULL, gtp_sound_play_merry_christmas,
+		gtp_sound_song_stop, 0);
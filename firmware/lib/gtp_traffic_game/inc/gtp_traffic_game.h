@@ -1,14 +0,0 @@
-#ifndef GTP_TRAFFIC_ESCAPE_GAME_H
-#define GTP_TRAFFIC_ESCAPE_GAME_H
-
-void gtp_traffic_escape_game_init();
-const char *gtp_traffic_escape_game_get_menu_title();
-void gtp_traffic_escape_game_start();
-int gtp_traffic_escape_game_play();
-
-void gtp_traffic_catch_game_init();
-const char *gtp_traffic_catch_game_get_menu_title();
-void gtp_traffic_catch_game_start();
-int gtp_traffic_catch_game_play();
-
-#endif /* GTP_TRAFFIC_ESCAPE_GAME_H */
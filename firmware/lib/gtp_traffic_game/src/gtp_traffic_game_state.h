@@ -0,0 +1,23 @@
+#ifndef GTP_TRAFFIC_GAME_STATE_H__
+#define GTP_TRAFFIC_GAME_STATE_H__
+
+#include <gtp_display.h>
+#include <gtp_game.h>
+
+typedef enum {
+	TRAFFIC_GAME_ESCAPE = 0,
+	TRAFFIC_GAME_CATCH = 1
+} traffic_game_mode_t;
+
+typedef struct {
+	// the display buffer that holds data
+	uint8_t buf[DISPLAY_WIDTH];
+	uint8_t buf_obstacles[DISPLAY_WIDTH];
+	uint8_t player_vertical_pos;
+	int8_t obstacle_idx;
+	uint8_t obstacle_row;
+	gtp_game_rand_t rng;
+	traffic_game_mode_t game_mode;
+} traffic_game_state_t;
+
+#endif /* GTP_TRAFFIC_GAME_STATE_H__ */
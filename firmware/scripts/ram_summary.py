@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+#
+# Prints the RAM used by the linked firmware and the size of every stack, run
+# after each build to see what an option costs or saves. The summary can be
+# saved and given as the baseline of another build to print the differences,
+# e.g. a build with CONFIG_GTP_DISPLAY_WORKQUEUE=n against the default one.
+#
+# The ELF is read with struct only, like gen_songs.py reads the MIDI files.
+
+import argparse
+import json
+import struct
+import sys
+
+SHT_SYMTAB = 2
+SHF_WRITE = 0x1
+SHF_ALLOC = 0x2
+STT_OBJECT = 1
+
+
+def read_sections(data):
+    """Returns the (name, flags, size, offset, link, entsize) of every section."""
+    if data[:4] != b'\x7fELF':
+        sys.exit('ram_summary: not an ELF file')
+    is64 = data[4] == 2
+    endian = '<' if data[5] == 1 else '>'
+
+    if is64:
+        shoff, = struct.unpack_from(endian + 'Q', data, 0x28)
+        shentsize, shnum, shstrndx = struct.unpack_from(endian + 'HHH', data, 0x3A)
+        fmt = endian + 'IIQQQQIIQQ'
+    else:
+        shoff, = struct.unpack_from(endian + 'I', data, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from(endian + 'HHH', data, 0x2E)
+        fmt = endian + 'IIIIIIIIII'
+
+    headers = [struct.unpack_from(fmt, data, shoff + i * shentsize) for i in range(shnum)]
+    strtab_offset = headers[shstrndx][4]
+
+    sections = []
+    for name, kind, flags, _, offset, size, link, _, _, entsize in headers:
+        end = data.index(b'\0', strtab_offset + name)
+        sections.append((data[strtab_offset + name:end].decode(), kind, flags, size, offset,
+                         link, entsize))
+    return sections, is64, endian
+
+
+def read_objects(data, sections, is64, endian):
+    """Returns the (name, size) of every data object of the symbol table."""
+    symtab = next((s for s in sections if s[1] == SHT_SYMTAB), None)
+    if symtab is None:
+        sys.exit('ram_summary: no symbol table')
+    _, _, _, size, offset, link, entsize = symtab
+    strtab_offset = sections[link][4]
+
+    objects = []
+    for pos in range(offset, offset + size, entsize):
+        if is64:
+            name, info, _, _, _, sym_size = struct.unpack_from(endian + 'IBBHQQ', data, pos)
+        else:
+            name, _, sym_size, info, _, _ = struct.unpack_from(endian + 'IIIBBH', data, pos)
+        if info & 0xF == STT_OBJECT:
+            end = data.index(b'\0', strtab_offset + name)
+            objects.append((data[strtab_offset + name:end].decode(), sym_size))
+    return objects
+
+
+def delta(value, baseline, key):
+    """Returns the difference with the baseline as text, empty without one."""
+    if baseline is None:
+        return ''
+    if key not in baseline:
+        return ' (new)'
+    return f' ({value - baseline[key]:+d})'
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Prints the RAM and stacks summary')
+    parser.add_argument('elf', help='zephyr.elf')
+    parser.add_argument('--ram-size', type=int, default=8192, help='RAM of the MCU in bytes')
+    parser.add_argument('--save', help='writes the summary to this JSON file')
+    parser.add_argument('--baseline', help='summary saved by another build to compare with')
+    args = parser.parse_args()
+
+    data = open(args.elf, 'rb').read()
+    sections, is64, endian = read_sections(data)
+
+    # .data, .bss, noinit and the kernel object sections are writable
+    ram = sum(size for _, _, flags, size, _, _, _ in sections
+              if flags & SHF_ALLOC and flags & SHF_WRITE)
+
+    # thread stacks are _k_thread_stack_<thread>, kernel ones z_*_stack(s)
+    stacks = sorted({(name, size) for name, size in read_objects(data, sections, is64, endian)
+                     if 'stack' in name and size >= 64}, key=lambda s: -s[1])
+    stacks_total = sum(size for _, size in stacks)
+
+    # read before saving, the baseline may be the summary of the previous build
+    # a missing baseline is not an error, it is only written by the other build
+    baseline = None
+    if args.baseline:
+        try:
+            baseline = json.load(open(args.baseline))
+        except OSError:
+            print(f'ram_summary: no baseline {args.baseline}, build it first')
+
+    summary = {'ram': ram, 'stacks': stacks_total, 'stack': dict(stacks)}
+    if args.save:
+        with open(args.save, 'w') as f:
+            json.dump(summary, f, indent=1)
+
+    free = args.ram_size - ram
+    print(f'RAM: {ram} / {args.ram_size} bytes used ({100 * ram // args.ram_size}%), '
+          f'{free} free{delta(ram, baseline, "ram")}')
+    print(f'stacks: {stacks_total} bytes{delta(stacks_total, baseline, "stacks")}')
+    for name, size in stacks:
+        print(f'  {name:<40} {size:>6}{delta(size, baseline and baseline["stack"], name)}')
+    if baseline is not None:
+        for name, size in baseline['stack'].items():
+            if name not in summary['stack']:
+                print(f'  {name:<40} {0:>6} ({-size:+d})')
+
+
+if __name__ == '__main__':
+    main()
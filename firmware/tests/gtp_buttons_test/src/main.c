@@ -80,6 +80,6 @@ int main()
 #endif
 
 	while (1) {
-		k_msleep(1000);
+		gtp_buttons_process_events(K_FOREVER);
 	}
 }
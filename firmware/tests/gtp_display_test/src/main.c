@@ -16,6 +16,13 @@ int main()
 
 	k_msleep(3000);
 
+	/* much longer than the sentence buffer, streamed from flash */
+	static const char credits[] = "gametoy made for christmas 2024 with a stm32 "
+				      "and zephyr rtos 0123456789";
+	gtp_display_print_const_sentence(credits);
+
+	k_msleep(30000);
+
 	gtp_display_set_menu_mode(true);
 
 	k_msleep(10000);
@@ -1,13 +1,14 @@
-#include <gtp_reactivity_game.h>
 #include <gtp_buttons.h>
+#include <gtp_game.h>
 #include <zephyr/kernel.h>
 
 int main()
 {
 	gtp_buttons_init();
-	gtp_reactivity_game_start();
+	gtp_game_init();
 
-	while (1) {
-		k_msleep(1000);
-	}
+	/* the reactivity game is the first one registered */
+	gtp_game_request_start(gtp_game_get(0));
+
+	gtp_game_run_dispatcher(NULL);
 }
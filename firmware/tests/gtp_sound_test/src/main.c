@@ -3,6 +3,7 @@
 #include <zephyr/device.h>
 #include <zephyr/drivers/pwm.h>
 #include <string.h>
+#include <gtp_sound.h>
 
 static const struct pwm_dt_spec pwm_led0 = PWM_DT_SPEC_GET(DT_ALIAS(pwmled0));
 
@@ -306,6 +307,16 @@ int main(void)
 	// Arrêter la PWM entre les notes
 	pwm_set_dt(&pwm_led0, PWM_HZ(1024u), 0);
 
+	// chords of 1 to GTP_SOUND_MAX_VOICES notes, arpeggiated by gtp_sound
+	static const uint16_t chord[] = {NOTE_D6, NOTE_FS6, NOTE_A6};
+
+	gtp_sound_init();
+	for (int count = 1; count <= ARRAY_SIZE(chord); count++) {
+		printk("chord of %d notes\n", count);
+		gtp_sound_play_chord(chord, count, 1000);
+		k_msleep(1500);
+	}
+
 	while (1) {
 		k_msleep(1000);
 	}